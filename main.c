@@ -1,11 +1,23 @@
+#define _GNU_SOURCE // For mmap, MAP_ANONYMOUS and sched_setaffinity under -std=c99
 #include "raylib.h"
 #include "raymath.h"
+#include "rlgl.h"   // For the default texture and shader ids
 #include <stdio.h>
 #include <stdlib.h> // For abs
 #include <stdbool.h>
 #include <string.h>
+#include <stddef.h> // For offsetof
 #include <float.h> // For FLT_MAX
 #include <math.h>  // For sinf, atan2f, and M_PI
+#include <stdint.h> // For fixed-point sim types
+#include <fcntl.h>    // For replay file mapping
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pthread.h>  // Replay writer thread
+#include <time.h>     // For clock
+#include <sys/wait.h> // For branch evaluation and batch workers
+#include <sched.h>    // For pinning batch workers
 
 // --- Game Constants ---
 #define SCREEN_WIDTH 1000
@@ -15,7 +27,13 @@
 #define cellWidth (GAME_AREA_WIDTH / GRID_SIZE)
 #define cellHeight (SCREEN_HEIGHT / GRID_SIZE)
 #define border_buff 10
-#define SPAWN_INTERVAL 0.35f // Slightly faster spawning
+#define SPAWN_INTERVAL FX(0.35f) // Slightly faster spawning
+#define SIM_TICKS_PER_SECOND 60
+#define SIM_TICK_DT ((FX_ONE + SIM_TICKS_PER_SECOND / 2) / SIM_TICKS_PER_SECOND) // Fixed sim step, Q16.16 seconds
+// Real seconds one tick stands for. 1/60 s has no exact Q16.16 value, so the frame loop drains
+// exactly what SIM_TICK_DT simulates and sim time never drifts against the wall clock.
+#define SIM_TICK_SECONDS ((float)SIM_TICK_DT / FX_ONE)
+#define MAX_SIM_TICKS_PER_FRAME 8 // Backlog beyond this carries over one frame, then game time slows instead of spiralling
 #define MAX_WAVES 30 // A win condition
 
 // --- Player Stats ---
@@ -35,6 +53,47 @@
 #define COLOR_UI_PANEL    (Color){20, 20, 30, 240}
 #define COLOR_UI_ACCENT   (Color){0, 180, 180, 255}
 #define COLOR_FROST       (Color){100, 160, 255, 200}
+#define COLOR_NEON_VIOLET (Color){170, 90, 255, 255}
+
+// --- Fixed-Point Math ---
+// The simulation runs in Q16.16 integers so results are bit-identical across compilers,
+// -ffast-math and FPU modes (needed for replays and lockstep). Floats only appear when
+// values are handed to rendering or the UI.
+typedef int32_t fixed_t;
+typedef struct { fixed_t x, y; } FxVec2;
+#define FX_SHIFT 16
+#define FX_ONE (1 << FX_SHIFT)
+#define FX(f) ((fixed_t)((f) * (double)FX_ONE + ((f) >= 0 ? 0.5 : -0.5))) // For constants only
+#define FX_INT(i) ((fixed_t)(i) * FX_ONE)
+
+static inline fixed_t FxMul(fixed_t a, fixed_t b) { return (fixed_t)(((int64_t)a * b) >> FX_SHIFT); }
+static inline fixed_t FxDiv(fixed_t a, fixed_t b) { return (fixed_t)(((int64_t)a * FX_ONE) / b); }
+static inline int64_t FxSquare(fixed_t v) { return (int64_t)v * v; } // Q32.32
+static inline int64_t FxDistanceSqr(FxVec2 a, FxVec2 b) { // Q32.32
+    int64_t dx = (int64_t)a.x - b.x, dy = (int64_t)a.y - b.y;
+    return dx * dx + dy * dy;
+}
+static inline int64_t ISqrt64(int64_t value) { // Exact floor square root, for deterministic lengths
+    if (value <= 0) return 0;
+    uint64_t x = (uint64_t)value, root = 0, bit = 1ULL << 62;
+    while (bit > x) bit >>= 2;
+    while (bit) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (int64_t)root;
+}
+static inline fixed_t FxClamp(fixed_t v, fixed_t lo, fixed_t hi) { return v < lo ? lo : v > hi ? hi : v; }
+static inline FxVec2 FxVec2Lerp(FxVec2 a, FxVec2 b, fixed_t t) {
+    return (FxVec2){a.x + FxMul(b.x - a.x, t), a.y + FxMul(b.y - a.y, t)};
+}
+static inline float FxToFloat(fixed_t v) { return (float)v / FX_ONE; }
+static inline Vector2 FxToVector2(FxVec2 v) { return (Vector2){FxToFloat(v.x), FxToFloat(v.y)}; }
 
 // --- Data Structures ---
 
@@ -51,6 +110,7 @@ typedef enum {
     TOWER_GUN,
     TOWER_SLOW,
     TOWER_SPLASH,
+    TOWER_CHAIN,
     TOWER_TYPE_COUNT
 } TowerType;
 
@@ -58,30 +118,31 @@ typedef enum {
 #define MAX_TOWER_LEVEL 4
 typedef struct {
     int cost;
-    float range;
-    float damage;
-    float fireRate;
-    float splashRadius; // Only for splash tower
+    fixed_t range;
+    fixed_t damage;
+    fixed_t fireRate;
+    fixed_t splashRadius; // Splash radius for splash tower, bounce radius for chain tower
+    int chainTargets;   // Only for chain tower: max enemies hit per shot
 } TowerLevelStats;
 
 TowerLevelStats g_towerStats[TOWER_TYPE_COUNT][MAX_TOWER_LEVEL];
-const char *g_towerNames[] = {"Gun Turret", "Frost Spire", "Cannon"};
+const char *g_towerNames[] = {"Gun Turret", "Frost Spire", "Cannon", "Tesla Coil"};
 const char *g_towerDescriptions[] = {
     "Fast-firing, single target damage dealer.",
     "Slows all enemies in a radius. Deals no damage.",
-    "Deals area-of-effect damage. Slower fire rate."
+    "Deals area-of-effect damage. Slower fire rate.",
+    "Arcs to nearby enemies. Weaker each jump."
 };
+#define CHAIN_DAMAGE_FALLOFF FX(0.8f) // Damage multiplier applied on every jump
 
-// MODIFIED: Tower struct now includes rotation for visuals
 typedef struct {
-    Vector2 pos;
+    FxVec2 center; // Screen-space center of the tower's cell
     bool active;
     TowerType type;
     int level;
-    float fireCooldown;
-    int targetIndex;
-    float rotation; // For turret visuals
-    float muzzleFlashTimer;
+    fixed_t fireCooldown;
+    int targetIndex; // Barrel orientation is derived from this at draw time
+    fixed_t muzzleFlashTimer;
 } Tower;
 
 // Enemy types
@@ -93,37 +154,112 @@ typedef enum {
     ENEMY_TYPE_COUNT
 } EnemyTypeEnum;
 
+// Enemy archetype table: id, loop suffix, speed (nodes/s), color, max health, money, radius.
+// InitializeEnemyTypes() and the per-archetype update loops are both generated from it,
+// so the loops see these values as literal constants.
+#define ENEMY_ARCHETYPES(X) \
+    X(ENEMY_NORMAL, Normal, 4.0f, COLOR_NEON_RED,              100.0f,   5,   cellWidth / 3.5f) \
+    X(ENEMY_SCOUT,  Scout,  8.0f, COLOR_NEON_ORANGE,           60.0f,    8,   cellWidth / 4.0f) \
+    X(ENEMY_TANK,   Tank,   2.0f, ((Color){200, 0, 200, 255}), 400.0f,   15,  cellWidth / 3.0f) \
+    X(ENEMY_BOSS,   Boss,   1.5f, ((Color){255, 255, 0, 255}), 10000.0f, 500, cellWidth / 2.0f)
+
 typedef struct {
-    float speed;
+    fixed_t speed;
     Color color;
-    float maxHealth;
+    fixed_t maxHealth;
     int money;
     float radius;
 } EnemyType;
 
 // MODIFIED: Enemy struct now has slow effect fields
+// Enemies advance only along the path; screen positions come from GetEnemyPos when needed
 typedef struct {
-    Vector2 pos;
     int type;
     int pathIndex;
-    float moveTimer;
+    fixed_t segmentProgress; // 0..FX_ONE along the segment from path[pathIndex] to path[pathIndex + 1]
     bool active;
-    float health;
-    float maxHealth;
-    float speedMultiplier; // For slow effects
-    float slowTimer;       // Duration of slow
-    float progress;        // Distance along the path, used for targeting
+    fixed_t health;          // Q16.16 caps at ~32767, above the strongest boss
+    fixed_t maxHealth;
+    fixed_t speedMultiplier; // For slow effects
+    fixed_t slowTimer;       // Duration of slow
+    fixed_t progress;        // Distance along the path in nodes, used for targeting and positions
+    fixed_t laneOffset;      // Sideways offset from the path centerline in pixels, set by SpreadEnemyLanes
 } Enemy;
 
 #define MAX_ENEMIES_PER_WAVE 150
+
+// Gun and cannon rounds in flight. They are sim state: damage lands when the round arrives.
+#define MAX_SHOTS 128
+#define GUN_SHOT_SPEED FX(1200.0f)   // Pixels per second
+#define CANNON_SHOT_SPEED FX(700.0f) // Faster than the fastest enemy, so every lead has a solution
+#define SHOT_HIT_RADIUS FX(cellWidth / 4.0f)
+typedef struct {
+    FxVec2 from, to;     // Muzzle and aim point
+    int targetIndex;
+    int towerType;
+    int ticksLeft;
+    int flightTicks;
+    fixed_t damage;
+    fixed_t splashRadius;
+} Shot;
 typedef struct {
-    Enemy enemies[MAX_ENEMIES_PER_WAVE];
+    Enemy enemies[MAX_ENEMIES_PER_WAVE]; // Grouped by type, spawned in index order
+    int typeRunStart[ENEMY_TYPE_COUNT + 1]; // Enemies of type t occupy [typeRunStart[t], typeRunStart[t + 1])
     int enemyCount;
-    float spawnTimer;
+    fixed_t spawnTimer;
     int enemiesSpawned;
     bool isFinished;
+    Shot shots[MAX_SHOTS]; // In flight against this wave's enemies
+    int shotCount;
 } EnemyWave;
 
+// Stretches of the path, as path distances in nodes, inclusive at both ends
+typedef struct {
+    fixed_t start, end;
+} PathInterval;
+
+// Where a tower's range overlaps the path, derived from its cell, range and the path.
+// Any enemy whose progress lies outside every interval is out of range, whatever its lane.
+#define MAX_COVERAGE_INTERVALS 8
+typedef struct {
+    PathInterval intervals[MAX_COVERAGE_INTERVALS];
+    int count;
+    fixed_t range;           // Range the intervals were computed for, 0 if none yet
+    uint32_t pathGeneration; // g_pathGeneration they were computed against
+    uint32_t version;        // Changes on every recompute
+} TowerCoverage;
+
+// Range-entry schedule, see the Kinetic Scheduling section
+#define MAX_KINETIC_EVENTS 4096
+#define ENEMY_BITSET_WORDS ((MAX_ENEMIES_PER_WAVE + 63) / 64)
+typedef struct {
+    int64_t tick;     // Sim tick whose movement carries the enemy onto the next coverage boundary
+    int enemyIndex;
+    uint32_t version; // Stale unless it matches the enemy's current schedule version
+} KineticEvent;
+
+typedef struct {
+    KineticEvent heap[MAX_KINETIC_EVENTS]; // Min-heap on tick, then enemy index
+    int eventCount;
+    uint32_t enemyVersion[MAX_ENEMIES_PER_WAVE];
+    uint64_t inside[GRID_SIZE][GRID_SIZE][ENEMY_BITSET_WORDS]; // Enemies within each armed tower's coverage
+    uint32_t armedVersion[GRID_SIZE][GRID_SIZE];                // Coverage version a tower was armed with, 0 if unarmed
+    int armedCells[GRID_SIZE * GRID_SIZE];
+    int armedCount;
+    fixed_t boundaries[GRID_SIZE * GRID_SIZE * MAX_COVERAGE_INTERVALS * 2]; // Sorted, where any armed coverage starts or ends
+    int boundaryCount;
+    int scheduledSpawns; // Spawned enemies below this index have been scheduled
+    int64_t now;         // Tick of the latest enemy movement
+} KineticSchedule;
+
+// Spatial grid over live enemies, built on the first neighbor query of a tick.
+// Uses the board cells as buckets so neighbor queries only visit nearby cells.
+typedef struct {
+    int cellStart[GRID_SIZE * GRID_SIZE + 1]; // Prefix offsets into enemyIndices
+    int enemyIndices[MAX_ENEMIES_PER_WAVE];
+    int count;
+} EnemyGrid;
+
 #define MAX_PROJECTILES 200
 typedef struct {
     Vector2 startPos;
@@ -134,9 +270,332 @@ typedef struct {
     float splashRadius; // NEW: To draw explosions correctly
 } Projectile;
 
+// Player commands: the only way player input changes sim state
+typedef enum {
+    CMD_BUILD_TOWER,
+    CMD_UPGRADE_TOWER,
+    CMD_SELL_TOWER,
+    CMD_START_WAVE
+} CommandType;
+
+typedef struct {
+    uint8_t type;      // CommandType
+    uint8_t x, y;      // Target cell
+    uint8_t towerType; // Only for CMD_BUILD_TOWER
+} GameCommand;
+
+// Complete sim state at a tick boundary. UI selection and visual effects are not included.
+typedef struct {
+    Tower towers[GRID_SIZE][GRID_SIZE];
+    EnemyWave wave;
+    GameState gameState;
+    int playerHealth;
+    int playerMoney;
+    int currentWaveNumber;
+    uint32_t simTick;
+} GameSnapshot;
+
+// Replay container, see the Replay System section for the layout
+#define REPLAY_MAGIC "TDRP"
+#define REPLAY_INDEX_MAGIC "TDIX"
+#define REPLAY_VERSION 5
+#define REPLAY_KEYFRAME_INTERVAL (10 * SIM_TICKS_PER_SECOND)
+#define REPLAY_QUEUE_CAPACITY 256
+
+typedef enum {
+    REPLAY_RECORD_COMMAND = 1,
+    REPLAY_RECORD_KEYFRAME_RAW = 2,
+    REPLAY_RECORD_KEYFRAME_DEFLATE = 3
+} ReplayRecordKind;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t gridSize;
+    uint32_t keyframeInterval;
+    uint8_t walls[GRID_SIZE][GRID_SIZE];
+    int32_t startX, startY, endX, endY;
+} ReplayHeader;
+
+typedef struct {
+    uint32_t tick;
+    uint32_t reserved;
+    uint64_t offset;     // Of the keyframe's record
+} ReplayIndexEntry;
+
+typedef struct {
+    uint64_t indexOffset;
+    uint32_t keyframeCount;
+    char magic[4];
+} ReplayFooter;
+
+// Work handed from the sim to the replay writer thread
+typedef struct {
+    uint8_t kind;           // ReplayRecordKind; keyframes are queued raw
+    uint32_t tick;
+    GameCommand command;
+    GameSnapshot *snapshot; // Owned by the job
+} ReplayWriteJob;
+
+typedef struct {
+    FILE *file;
+    bool compressKeyframes;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty, notFull;
+    ReplayWriteJob queue[REPLAY_QUEUE_CAPACITY];
+    int queueHead, queueCount;
+    bool closing;
+    uint32_t lastKeyframeTick;
+    // Owned by the writer thread until it is joined
+    uint64_t bytesWritten;
+    uint32_t lastWrittenTick;
+    ReplayIndexEntry *index;
+    int keyframeCount, indexCapacity;
+} ReplayRecorder;
+
+typedef struct {
+    const uint8_t *data;          // Memory-mapped file, NULL when no replay is open
+    size_t size;
+    const ReplayHeader *header;
+    const ReplayIndexEntry *index;
+    ReplayIndexEntry *ownedIndex; // Set when the index had to be rebuilt by scanning
+    int keyframeCount;
+    size_t recordsEnd;
+    size_t cursor;                // Next record to read
+    uint32_t cursorTick;          // Tick of the record before the cursor
+    uint32_t endTick;
+} ReplayViewer;
+
+// A decoded replay record; payload points into the mapped file
+typedef struct {
+    uint8_t kind;
+    uint32_t tick;
+    GameCommand command;
+    const uint8_t *payload;
+    uint32_t payloadSize;
+    size_t next;                  // Offset of the following record
+} ReplayRecord;
+
+// Per-tick telemetry, see the Telemetry section for the encoding
+#define TELEMETRY_MAGIC "TDTM"
+#define TELEMETRY_VERSION 2
+#define TELEMETRY_BLOCK_SIZE 128
+
+typedef enum {
+    TELEMETRY_MONEY,
+    TELEMETRY_HEALTH,
+    TELEMETRY_LIVE_ENEMIES,
+    TELEMETRY_COLUMN_COUNT
+} TelemetryColumn;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t columnCount;
+    uint32_t blockSize;
+} TelemetryHeader;
+
+typedef struct {
+    bool enabled;
+    const char *filename;
+    FILE *file; // Opened by the first flushed block
+    int32_t columns[TELEMETRY_COLUMN_COUNT][TELEMETRY_BLOCK_SIZE]; // The block being filled
+    uint32_t count;
+    uint32_t run;       // Bumped by every restart
+    uint32_t firstTick; // simTick of the block's first row
+    uint32_t lastTick;  // simTick of the newest row; ticks replayed after a seek back are not recorded again
+} TelemetryLog;
+
+// Batch simulation, see the Batch Simulation section
+#define CACHE_LINE_SIZE 64
+#define MAX_BATCH_WORKERS 256
+#define BATCH_MAX_TICKS (60 * 60 * SIM_TICKS_PER_SECOND) // Gives up on games that stall
+
+typedef enum {
+    STRATEGY_RANDOM,        // Any affordable build or upgrade
+    STRATEGY_UPGRADE_FIRST, // Upgrades whenever one is affordable
+    STRATEGY_COUNT
+} Strategy;
+
+// Multipliers applied to the stat tables by InitializeGame; all 1 outside of sweeps
+typedef enum {
+    BALANCE_TOWER_DAMAGE,
+    BALANCE_TOWER_COST,
+    BALANCE_ENEMY_HEALTH,
+    BALANCE_ENEMY_SPEED,
+    BALANCE_STAT_COUNT
+} BalanceStat;
+
+typedef struct {
+    fixed_t scale[BALANCE_STAT_COUNT];
+} BalanceScales;
+
+typedef struct {
+    uint32_t seed;
+    uint8_t strategy;
+    uint16_t mapIndex;      // Into g_batchMaps, when set
+    BalanceScales balance;
+} BatchScenario;
+
+typedef struct {
+    uint8_t walls[GRID_SIZE][GRID_SIZE];
+    Vector2 start, end;
+    char name[256]; // Manifest path, same size as the buffer LoadSweepManifest reads it into
+} MapData;
+
+typedef struct {
+    uint32_t seed;
+    uint8_t strategy;
+    uint8_t victory;
+    uint8_t done;
+    uint8_t estimated;      // Outcome came from EstimateBatchGame, not a full simulation
+    int32_t waveReached;
+    int32_t playerHealth;
+    int32_t playerMoney;
+    uint32_t ticks;
+} BatchResult;
+
+// Outcome estimation, see the Outcome Estimation section
+#define ESTIMATE_MARGIN FX(0.3f)   // Tower damage is scaled down and up by this to bracket an estimate
+#define ESTIMATE_AUDIT_INTERVAL 16 // Seeds divisible by this are simulated even when the estimate is clear
+
+// Estimator accuracy against full simulation
+typedef struct {
+    int games;
+    int outcomeMatches;     // Same victory flag and wave reached
+    int64_t waveError;      // Sums of absolute differences
+    int64_t healthError;
+} EstimateScore;
+
+// One per worker, each on its own cache lines
+typedef struct {
+    int cpu, node;
+    int games;
+    int estimatedGames;     // Games whose result is the estimate; their ticks are not counted
+    uint64_t ticks;
+    double seconds;           // Spent simulating; estimates are timed separately
+    double estimateSeconds;
+    EstimateScore closeScore; // Games the estimate could not call, simulated
+    EstimateScore auditScore; // Games it did call, simulated anyway as a check
+} __attribute__((aligned(CACHE_LINE_SIZE))) BatchWorkerStats;
+
+// Lives in a MAP_SHARED mapping; stats and results follow the struct
+typedef struct {
+    size_t mappedSize;
+    int count, workerCount;
+    BatchWorkerStats *stats;
+    BatchResult *results;
+} BatchRun;
+
+// Bump allocator over a private mapping
+typedef struct {
+    uint8_t *base;
+    size_t size, used;
+} Arena;
+
+// Sweeps, see the Sweeps section
+#define SWEEP_GAMES_PER_WORKER 8 // Per chunk; results are synced to disk after each chunk
+
+typedef struct {
+    uint32_t hash;          // Of the manifest text, stamped into every result file
+    MapData *maps;
+    int mapCount;
+    uint8_t strategies[STRATEGY_COUNT];
+    int strategyCount;
+    uint32_t firstSeed, seedCount;
+    fixed_t statMin[BALANCE_STAT_COUNT], statMax[BALANCE_STAT_COUNT];
+    int statSteps[BALANCE_STAT_COUNT];
+    uint64_t unitCount;
+} SweepManifest;
+
+// Video export, see the Video Export section
+#define VIDEO_PIPELINE_DEPTH 16
+#define VIDEO_ENCODER_THREADS 4
+
+typedef enum {
+    VIDEO_SLOT_FREE,
+    VIDEO_SLOT_CAPTURED,  // Read back, waiting for an encoder
+    VIDEO_SLOT_ENCODING,
+    VIDEO_SLOT_ENCODED    // Waiting for the writer
+} VideoSlotState;
+
+typedef struct {
+    Image frame;
+    uint8_t *encoded;
+    size_t encodedSize;
+    VideoSlotState state;
+} VideoSlot;
+
+typedef struct {
+    FILE *file;           // Y4M stream, NULL when writing a PNG sequence
+    const char *pngDir;
+    int width, height, fps;
+    VideoSlot slots[VIDEO_PIPELINE_DEPTH];
+    int framesCaptured, framesWritten;
+    bool closing, failed;
+    pthread_t encoders[VIDEO_ENCODER_THREADS], writer;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} VideoExporter;
+
+// Autosave, see the Autosave section
+#define AUTOSAVE_MAGIC "TDSV"
+#define AUTOSAVE_VERSION 4
+#define AUTOSAVE_PATH "autosave.tds"
+#define AUTOSAVE_INTERVAL 15.0f // Real seconds between saves
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t gridSize;
+    uint8_t walls[GRID_SIZE][GRID_SIZE];
+    int32_t startX, startY, endX, endY;
+    float gameSpeed;
+    GameSnapshot snapshot;
+    uint32_t checksum; // FNV-1a of every byte before it
+} SaveFile;
+
+typedef struct {
+    bool enabled;
+    const char *path;
+    Vector2 startPos, endPos;
+    float timer;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    SaveFile pending;
+    bool hasPending, closing;
+} Autosaver;
+
+// Branch evaluation, see the Branch Evaluation section
+#define MAX_BRANCH_WORKERS 64
+#define MAX_BRANCH_CANDIDATES (GRID_SIZE * GRID_SIZE * TOWER_TYPE_COUNT + 1)
+
+typedef struct {
+    GameCommand command;
+    uint8_t applied;   // Whether the candidate command was valid at the branch point
+    uint8_t done;      // Set by the worker once the fields below are final
+    int32_t playerHealth;
+    int32_t playerMoney;
+    int32_t waveNumber;
+    int32_t gameState;
+    uint32_t endTick;
+} BranchResult;
+
+// Lives in a MAP_SHARED mapping so worker processes can fill it in
+typedef struct {
+    int nextCandidate; // Claimed with an atomic add
+    int count;
+    size_t mappedSize;
+    BranchResult results[];
+} BranchTable;
+
 // --- Global Variables ---
 bool walls[GRID_SIZE][GRID_SIZE] = {0};
 Vector2 path[GRID_SIZE * GRID_SIZE];
+FxVec2 pathPoints[GRID_SIZE * GRID_SIZE]; // Screen-space node centers used by the sim
+FxVec2 pathNormals[GRID_SIZE * GRID_SIZE]; // Unit sideways direction of each segment, for lane offsets
 int pathLength = 0;
 Tower towers[GRID_SIZE][GRID_SIZE] = {0};
 
@@ -144,6 +603,15 @@ EnemyType enemyTypes[ENEMY_TYPE_COUNT];
 EnemyWave activeWave;
 Projectile projectiles[MAX_PROJECTILES];
 int projectileCount = 0;
+EnemyGrid enemyGrid;
+uint32_t g_enemyGridEpoch;                   // g_enemyPosEpoch the grid was built in
+FxVec2 g_enemyPosCache[MAX_ENEMIES_PER_WAVE];
+uint32_t g_enemyPosStamp[MAX_ENEMIES_PER_WAVE]; // Cache entries are valid when equal to g_enemyPosEpoch
+uint32_t g_enemyPosEpoch = 1;                // Bumped whenever enemies may have moved
+TowerCoverage g_towerCoverage[GRID_SIZE][GRID_SIZE];
+uint32_t g_pathGeneration = 1;               // Bumped by FindPathBFS
+uint32_t g_coverageVersion;                  // Last TowerCoverage version handed out
+KineticSchedule g_kinetic;
 
 GameState gameState;
 int playerHealth;
@@ -151,9 +619,191 @@ int playerMoney;
 int currentWaveNumber;
 float gameSpeed = 1.0f;
 bool g_isPaused = false;
+float simTimeAccumulator = 0.0f; // Real seconds not yet consumed by fixed sim ticks
+uint32_t simTick = 0;            // Sim ticks elapsed in the current run
+bool g_muteSimSounds = false;    // Set while re-simulating so catch-up ticks stay silent
+bool g_hidePopups = false;       // Set for seeks, branches and batch runs, whose ticks are never shown
+bool g_skipIdleTicks = false;    // Headless runs jump over ticks where nothing interacts, see Time Skipping
+bool g_prescreen = false;        // Batch and sweep games are estimated first, see Outcome Estimation
+
+ReplayRecorder replayRecorder;
+ReplayViewer replayViewer;
+TelemetryLog telemetry;
+Autosaver autosaver;
+BalanceScales g_balance = {{FX_ONE, FX_ONE, FX_ONE, FX_ONE}};
+const MapData *g_batchMaps = NULL; // Maps batch scenarios index into; NULL keeps the loaded map
 
 // UI and Selection state
 int g_selectedTowerX = -1, g_selectedTowerY = -1;
+
+// Panel widgets, laid out by LayoutGameUI from game state. HandleInput hit-tests them before
+// the sim tick; the Draw*UI functions only draw them.
+typedef enum {
+    UI_NONE,
+    UI_START_WAVE,
+    UI_SELECT_BUILD, // index is the TowerType
+    UI_UPGRADE,
+    UI_SELL,
+    UI_TOWER_STATS   // Selected tower's title and stat lines; drawn only, never activated
+} UiElementKind;
+
+typedef struct {
+    UiElementKind kind;
+    int index;
+    Rectangle bounds;
+} UiElement;
+
+#define MAX_UI_ELEMENTS (TOWER_TYPE_COUNT + 3)
+#define MAX_TOWER_STAT_LINES 4
+#define UI_STATS_HEADER_HEIGHT 60 // Title and tower name above the stat lines
+#define UI_STAT_LINE_HEIGHT 20
+#define UI_STATS_GAP 20           // Between the stat lines and the upgrade button
+typedef struct {
+    UiElement elements[MAX_UI_ELEMENTS];
+    int count;
+} UiLayout;
+
+UiElement g_uiHovered = {UI_NONE}; // Set by HandleInput, read by drawing for highlights
+
+// Sprite atlas, see the Sprite Atlas section
+#define SPRITE_ATLAS_PATH "resources/atlas.png"
+#define SPRITE_ATLAS_COLUMNS 4
+#define SPRITE_ATLAS_ROWS 2
+
+typedef enum {
+    SPRITE_TOWER_BODY,                            // One per TowerType
+    SPRITE_GUN_BARREL = SPRITE_TOWER_BODY + TOWER_TYPE_COUNT,
+    SPRITE_DISC,
+    SPRITE_RING,
+    SPRITE_PIXEL,
+    SPRITE_COUNT
+} SpriteId;
+
+Texture2D g_spriteAtlas;
+Rectangle g_spriteRects[SPRITE_COUNT];
+
+// Animated effects, see the Effect Shader section
+typedef enum {
+    EFFECT_FROST_AURA,   // Instance alpha scales the pulse; 0 holds it still
+    EFFECT_MUZZLE_FLASH, // Instance color is the flash color and brightness
+    EFFECT_EXPLOSION,    // Instance alpha is the progress through the blast
+    EFFECT_KIND_COUNT
+} EffectKind;
+
+typedef struct {
+    Vector2 center;
+    float halfSize;
+    EffectKind kind;
+    Color data;
+} EffectInstance;
+
+#define MAX_EFFECTS (GRID_SIZE * GRID_SIZE + MAX_PROJECTILES) // One per tower and one per explosion at most
+#define FROST_AURA_RADIUS (cellWidth / 3.0f)
+#define FROST_CORE_RADIUS (cellWidth / 4.5f)
+#define FROST_PULSE_AMPLITUDE 3.0f
+#define EFFECT_SLOTS (2 * EFFECT_KIND_COUNT) // Texel width the effect quads pretend to sample from
+#define EFFECT_SLOTS_GLSL "6.0"              // EFFECT_SLOTS as a GLSL literal
+
+EffectInstance g_effects[MAX_EFFECTS];
+int g_effectCount = 0;
+Shader g_effectShader;
+bool g_effectShaderReady = false;
+int g_effectTimeLoc = -1;
+
+// Background chunks, see the Background Chunks section
+#define BACKGROUND_CHUNK_CELLS 4
+#define BACKGROUND_CHUNKS ((GRID_SIZE + BACKGROUND_CHUNK_CELLS - 1) / BACKGROUND_CHUNK_CELLS)
+#define BACKGROUND_CHUNK_BUDGET (4 * 1024 * 1024) // Bytes of chunk textures kept resident
+
+// Per-cell bits a chunk's pixels depend on
+enum {
+    CELL_WALL       = 1 << 0,
+    CELL_LINK_UP    = 1 << 1, // Path continues into the neighbouring cell
+    CELL_LINK_DOWN  = 1 << 2,
+    CELL_LINK_LEFT  = 1 << 3,
+    CELL_LINK_RIGHT = 1 << 4
+};
+
+typedef struct {
+    RenderTexture2D texture;
+    bool loaded;
+    unsigned char cells[BACKGROUND_CHUNK_CELLS][BACKGROUND_CHUNK_CELLS]; // Cell bits it was rendered from
+} BackgroundChunk;
+
+BackgroundChunk g_backgroundChunks[BACKGROUND_CHUNKS][BACKGROUND_CHUNKS];
+size_t g_backgroundBytes = 0;
+unsigned char g_pathLinks[GRID_SIZE][GRID_SIZE]; // CELL_LINK_* bits of the current path, set by FindPathBFS
+
+// Visible part of the board in world space; the whole board until the view scrolls
+Rectangle g_cameraView = {0, 0, GAME_AREA_WIDTH, SCREEN_HEIGHT};
+
+// Minimap, see the Minimap section
+#define MINIMAP_SIZE 120
+#define MINIMAP_Y 592
+#define MINIMAP_BINS_PER_NODE 2 // Density histogram resolution along the path
+
+typedef struct {
+    RenderTexture2D texture;
+    bool loaded;
+    unsigned char cells[GRID_SIZE][GRID_SIZE]; // Cell and tower bits it was rendered from
+} Minimap;
+
+Minimap g_minimap;
+int g_minimapHistogram[GRID_SIZE * GRID_SIZE * MINIMAP_BINS_PER_NODE];
+
+// Damage and gold popups, see the Popups section
+#define MAX_POPUPS 128
+#define POPUP_LIFETIME 0.8f
+#define POPUP_MERGE_WINDOW 0.25f // Hits on an enemy within this long of its last one add to the same popup
+#define POPUP_GLYPHS "0123456789+$"
+#define POPUP_GLYPH_COUNT 12
+#define POPUP_GLYPH_WIDTH 14
+#define POPUP_GLYPH_HEIGHT 20
+
+typedef enum { POPUP_DAMAGE, POPUP_GOLD } PopupKind;
+
+typedef struct {
+    PopupKind kind;
+    int enemyIndex;  // Damage popups merge per enemy; -1 for gold
+    fixed_t value;   // Damage or gold, in sim units
+    Vector2 pos;
+    float age;
+} Popup;
+
+Popup g_popups[MAX_POPUPS];
+int g_popupCount = 0;
+int g_popupByEnemy[MAX_ENEMIES_PER_WAVE]; // Slot of each enemy's latest damage popup, validated on use
+Texture2D g_glyphAtlas;
+int g_glyphAdvance[POPUP_GLYPH_COUNT];
+
+// Render clock; the video exporter runs it at a fixed rate instead of real time
+float g_renderDt = 0.0f;
+double g_renderTime = 0.0;
+
+// Visual quality, lowered by the governor when frames run over budget. Each level keeps the cuts of the ones before it.
+typedef enum {
+    QUALITY_FULL,
+    QUALITY_NO_FULL_HEALTH_BARS, // Health bars only on damaged enemies
+    QUALITY_MERGED_BEAMS,        // Beams as hairlines in one line batch
+    QUALITY_STATIC_FROST,        // No frost pulse animation
+    QUALITY_NEAR_PIPS_ONLY,      // Level pips only near the cursor or selection
+    QUALITY_LEVEL_COUNT
+} QualityLevel;
+
+#define QUALITY_FRAME_BUDGET (1.0f / 60.0f)
+#define QUALITY_DEGRADE_LOAD 0.8f   // Of the budget, sustained for QUALITY_DEGRADE_FRAMES
+#define QUALITY_RESTORE_LOAD 0.45f  // Of the budget, sustained for QUALITY_RESTORE_FRAMES
+#define QUALITY_DEGRADE_FRAMES 30
+#define QUALITY_RESTORE_FRAMES 180
+#define QUALITY_PIP_RADIUS (3 * cellWidth)
+
+int g_qualityLevel = QUALITY_FULL;
+float g_frameLoad = 0.0f; // Smoothed frame cost as a fraction of the budget
+int g_qualityStreak = 0;  // Frames in a row past one of the thresholds
+
+// Render-only turret state, updated once per displayed frame
+#define TURRET_TURN_RATE 18.0f // Smoothing rate for barrel rotation, 1/s
+float g_towerRotation[GRID_SIZE][GRID_SIZE]; // Barrel angle in degrees
 TowerType g_selectedBuildType = -1; // -1 means no selection
 
 // Audio
@@ -170,53 +820,181 @@ void LoadGameAudio();
 void UnloadGameAudio();
 void CreateWave(int waveNumber);
 void UpdateGame(float dt);
+void SimulateTick(fixed_t dt);
+void SimulateUntil(uint32_t endTick);
+int FindIdleTicks(int maxTicks, fixed_t dt, bool *engaged);
+void SkipIdleTicks(int ticks, fixed_t dt);
 void HandleInput();
-void UpdateWave(EnemyWave *wave, float dt);
-void UpdateEnemies(EnemyWave *wave, float dt);
-void UpdateTowers(float dt);
+void UpdateWave(EnemyWave *wave, fixed_t dt);
+void UpdateEnemies(EnemyWave *wave, fixed_t dt);
+void CollectKilledEnemies(EnemyWave *wave);
+void UpdateEnemyProgress(Enemy *enemy);
+FxVec2 GetEnemyPos(int index);
+void InvalidateEnemyPositions();
+const TowerCoverage *GetTowerCoverage(int x, int y);
+bool IsInCoverage(const TowerCoverage *coverage, fixed_t progress);
+void ResetKineticSchedule();
+void AdvanceKineticSchedule(fixed_t dt);
+void RescheduleEnemy(int index, fixed_t dt);
+int GetTowerCandidates(int x, int y, fixed_t dt, int *outIndices);
+bool IsTowerCandidate(int x, int y, int index);
+void SpreadEnemyLanes(EnemyWave *wave);
+void UpdateTowers(fixed_t dt);
+void UpdateShots();
+FxVec2 GetPathPosition(fixed_t distance, fixed_t laneOffset);
+fixed_t PredictEnemyDistance(const Enemy *enemy, int ticks, fixed_t dt);
+FxVec2 PredictEnemyPosition(const Enemy *enemy, int ticks, fixed_t dt);
+int SolveInterceptTicks(const Enemy *enemy, FxVec2 from, fixed_t shotStep, fixed_t dt);
+int64_t TicksToReachDistance(const Enemy *enemy, fixed_t distance, fixed_t dt);
+void BuildEnemyGrid(const EnemyWave *wave);
+int FindNearestEnemies(FxVec2 center, fixed_t radius, int k, const bool *excluded, int *outIndices);
 void CheckWaveCompletion();
 void DrawGame();
 void DrawGameUI();
-void DrawBuildUI();
-void DrawSelectionUI();
+void LayoutGameUI(UiLayout *layout);
+const UiElement *FindUIElement(const UiLayout *layout, UiElementKind kind, int index);
+const UiElement *HitTestUI(const UiLayout *layout, Vector2 point);
+void ActivateUIElement(const UiElement *element);
+void DrawBuildUI(const UiLayout *layout);
+void DrawSelectionUI(const UiLayout *layout);
 void DrawEnemies(const EnemyWave *wave);
 void DrawTowers();
 void DrawWall(int cellX, int cellY);
+void UpdateBackground(Rectangle view);
+void DrawBackground(Rectangle view);
+void UnloadBackground();
+void UpdateMinimap();
+void DrawMinimap(Rectangle bounds);
+void UnloadMinimap();
+void LoadPopupGlyphs();
+void UnloadPopupGlyphs();
+void ShowDamagePopup(int enemyIndex, FxVec2 pos, fixed_t damage);
+void ShowGoldPopup(FxVec2 pos, int money);
+void UpdateAndDrawPopups(float dt);
+void LoadSpriteAtlas();
+void UnloadSpriteAtlas();
+void LoadEffectShader();
+void UnloadEffectShader();
+void FlushEffects();
+void DrawGameScene(float projectileDt);
 void UpdateAndDrawProjectiles(float dt);
+void DrawShots();
+void UpdateQualityGovernor(float workSeconds, float frameSeconds);
 void FireProjectile(Vector2 startPos, Vector2 endPos, Color color, bool isSplash, float splashRadius);
 void UpgradeSelectedTower();
 void SellSelectedTower();
+int GetTowerSellValue(const Tower *tower);
+bool ApplyCommand(const GameCommand *cmd);
+bool IssueCommand(GameCommand cmd);
+void CaptureSnapshot(GameSnapshot *snapshot);
+void RestoreSnapshot(const GameSnapshot *snapshot);
+bool StartReplayRecording(const char *filename, Vector2 startPos, Vector2 endPos, bool compress);
+void RecordReplayCommand(const GameCommand *cmd);
+void RecordReplayTick();
+void FinishReplayRecording();
+bool OpenReplay(const char *filename, ReplayViewer *viewer);
+void CloseReplay(ReplayViewer *viewer);
+bool LoadReplayMap(const ReplayViewer *viewer);
+bool StepReplay(ReplayViewer *viewer);
+void SeekReplay(ReplayViewer *viewer, uint32_t targetTick);
+void UpdateReplayViewer(float dt);
+Rectangle GetReplayTimelineRect();
+void DrawReplayTimeline();
+void RecordTelemetryTick();
+void FinishTelemetry();
+void StartTelemetryRun();
+int DumpTelemetry(const char *filename);
+int GenerateBranchCandidates(GameCommand *out, int maxCount);
+BranchTable *EvaluateBranches(const GameCommand *candidates, int count, uint32_t horizonTicks, int workerCount);
+void FreeBranchTable(BranchTable *table);
+int RunBranchTool(const char *replayPath, float atSeconds, float horizonSeconds, int workerCount);
+int FindStrategy(const char *name);
+BatchRun *RunBatch(const BatchScenario *scenarios, int count, int workerCount);
+void FreeBatchRun(BatchRun *run);
+void PrintBatchReport(const BatchRun *run, FILE *out);
+void PrintBatchResults(const BatchRun *run, FILE *out);
+void PlayBatchScenario(const BatchScenario *scenario, BatchResult *result, BatchWorkerStats *stats);
+void EstimateBatchGame(const BatchScenario *scenario, fixed_t damageScale, BatchResult *result);
+void PrintEstimateReport(const BatchRun *run, FILE *out);
+int RunBatchTool(int gameCount, uint32_t firstSeed, int strategy, int workerCount);
+bool LoadSweepManifest(const char *filename, SweepManifest *manifest);
+int RunSweepShard(const char *manifestPath, int shardIndex, int shardCount, const char *outPath, int workerCount);
+int MergeSweepResults(const char *manifestPath, char **resultPaths, int resultCount);
+bool StartVideoExport(VideoExporter *video, const char *outPath, int width, int height, int fps);
+void SubmitVideoFrame(VideoExporter *video, Image frame);
+bool FinishVideoExport(VideoExporter *video);
+int RunVideoTool(const char *replayPath, const char *outPath, int fps, float speed);
+bool StartAutosave(const char *path, Vector2 startPos, Vector2 endPos);
+void UpdateAutosave(float dt);
+void StopAutosave();
+bool LoadAutosave(const char *path, SaveFile *save, Vector2 *startPos, Vector2 *endPos);
+void ApplyAutosave(const SaveFile *save);
 bool LoadMap(const char *filename, Vector2 *startPos, Vector2 *endPos);
 bool FindPathBFS(Vector2 start, Vector2 end);
 
 // --- Game Logic ---
 
+static void PlaySimSound(Sound sound) {
+    if (!g_muteSimSounds) PlaySound(sound);
+}
+
+// Tower damage, with its popup. The hit that takes an enemy to zero also shows the bounty.
+static void DamageEnemy(int index, fixed_t damage) {
+    Enemy *enemy = &activeWave.enemies[index];
+    bool wasAlive = enemy->health > 0;
+    enemy->health -= damage;
+    if (g_hidePopups) return; // Catch-up and headless ticks show nothing
+    FxVec2 pos = GetEnemyPos(index);
+    ShowDamagePopup(index, pos, damage);
+    if (wasAlive && enemy->health <= 0) ShowGoldPopup(pos, enemyTypes[enemy->type].money);
+}
+
 void InitializeTowerStats() {
     // Level 0 is base
     // Gun Tower: Standard single-target damage
-    g_towerStats[TOWER_GUN][0] = (TowerLevelStats){50, 2.5f * cellWidth, 40.0f, 2.0f, 0};
-    g_towerStats[TOWER_GUN][1] = (TowerLevelStats){75, 2.7f * cellWidth, 65.0f, 2.2f, 0};
-    g_towerStats[TOWER_GUN][2] = (TowerLevelStats){100, 3.0f * cellWidth, 90.0f, 2.5f, 0};
-    g_towerStats[TOWER_GUN][3] = (TowerLevelStats){150, 3.3f * cellWidth, 130.0f, 3.0f, 0};
+    g_towerStats[TOWER_GUN][0] = (TowerLevelStats){50, FX(2.5f * cellWidth), FX(40.0f), FX(2.0f), 0};
+    g_towerStats[TOWER_GUN][1] = (TowerLevelStats){75, FX(2.7f * cellWidth), FX(65.0f), FX(2.2f), 0};
+    g_towerStats[TOWER_GUN][2] = (TowerLevelStats){100, FX(3.0f * cellWidth), FX(90.0f), FX(2.5f), 0};
+    g_towerStats[TOWER_GUN][3] = (TowerLevelStats){150, FX(3.3f * cellWidth), FX(130.0f), FX(3.0f), 0};
 
     // Slow Tower: No damage, but slows enemies in an area. Fire rate is how often it pulses.
-    g_towerStats[TOWER_SLOW][0] = (TowerLevelStats){60, 2.0f * cellWidth, 0.5f, 1.0f, 0}; // Damage is slow %
-    g_towerStats[TOWER_SLOW][1] = (TowerLevelStats){80, 2.2f * cellWidth, 0.4f, 1.0f, 0};
-    g_towerStats[TOWER_SLOW][2] = (TowerLevelStats){100, 2.4f * cellWidth, 0.3f, 1.0f, 0};
-    g_towerStats[TOWER_SLOW][3] = (TowerLevelStats){140, 2.6f * cellWidth, 0.2f, 1.0f, 0};
+    g_towerStats[TOWER_SLOW][0] = (TowerLevelStats){60, FX(2.0f * cellWidth), FX(0.5f), FX(1.0f), 0}; // Damage is slow %
+    g_towerStats[TOWER_SLOW][1] = (TowerLevelStats){80, FX(2.2f * cellWidth), FX(0.4f), FX(1.0f), 0};
+    g_towerStats[TOWER_SLOW][2] = (TowerLevelStats){100, FX(2.4f * cellWidth), FX(0.3f), FX(1.0f), 0};
+    g_towerStats[TOWER_SLOW][3] = (TowerLevelStats){140, FX(2.6f * cellWidth), FX(0.2f), FX(1.0f), 0};
 
     // Splash Tower: Slower, but damages enemies in a radius
-    g_towerStats[TOWER_SPLASH][0] = (TowerLevelStats){100, 2.2f * cellWidth, 50.0f, 0.8f, 0.8f * cellWidth};
-    g_towerStats[TOWER_SPLASH][1] = (TowerLevelStats){120, 2.4f * cellWidth, 70.0f, 0.9f, 0.9f * cellWidth};
-    g_towerStats[TOWER_SPLASH][2] = (TowerLevelStats){160, 2.6f * cellWidth, 100.0f, 1.0f, 1.0f * cellWidth};
-    g_towerStats[TOWER_SPLASH][3] = (TowerLevelStats){220, 2.8f * cellWidth, 140.0f, 1.1f, 1.1f * cellWidth};
+    g_towerStats[TOWER_SPLASH][0] = (TowerLevelStats){100, FX(2.2f * cellWidth), FX(50.0f), FX(0.8f), FX(0.8f * cellWidth)};
+    g_towerStats[TOWER_SPLASH][1] = (TowerLevelStats){120, FX(2.4f * cellWidth), FX(70.0f), FX(0.9f), FX(0.9f * cellWidth)};
+    g_towerStats[TOWER_SPLASH][2] = (TowerLevelStats){160, FX(2.6f * cellWidth), FX(100.0f), FX(1.0f), FX(1.0f * cellWidth)};
+    g_towerStats[TOWER_SPLASH][3] = (TowerLevelStats){220, FX(2.8f * cellWidth), FX(140.0f), FX(1.1f), FX(1.1f * cellWidth)};
+
+    // Chain Tower: Hits the target, then jumps to the nearest un-hit enemies within the bounce radius
+    g_towerStats[TOWER_CHAIN][0] = (TowerLevelStats){120, FX(2.3f * cellWidth), FX(35.0f), FX(1.2f), FX(1.2f * cellWidth), 3};
+    g_towerStats[TOWER_CHAIN][1] = (TowerLevelStats){140, FX(2.4f * cellWidth), FX(45.0f), FX(1.3f), FX(1.3f * cellWidth), 4};
+    g_towerStats[TOWER_CHAIN][2] = (TowerLevelStats){180, FX(2.6f * cellWidth), FX(60.0f), FX(1.4f), FX(1.4f * cellWidth), 5};
+    g_towerStats[TOWER_CHAIN][3] = (TowerLevelStats){240, FX(2.8f * cellWidth), FX(80.0f), FX(1.5f), FX(1.5f * cellWidth), 6};
 }
 
 void InitializeEnemyTypes() {
-    enemyTypes[ENEMY_NORMAL] = (EnemyType){4.0f, COLOR_NEON_RED, 100.0f, 5, cellWidth / 3.5f};
-    enemyTypes[ENEMY_SCOUT] = (EnemyType){8.0f, COLOR_NEON_ORANGE, 60.0f, 8, cellWidth / 4.0f};
-    enemyTypes[ENEMY_TANK] = (EnemyType){2.0f, (Color){200, 0, 200, 255}, 400.0f, 15, cellWidth / 3.0f};
-    enemyTypes[ENEMY_BOSS] = (EnemyType){1.5f, (Color){255, 255, 0, 255}, 10000.0f, 500, cellWidth / 2.0f};
+#define X(id, name, speed, color, maxHealth, money, radius) enemyTypes[id] = (EnemyType){FX(speed), color, FX(maxHealth), money, radius};
+    ENEMY_ARCHETYPES(X)
+#undef X
+}
+
+// Scales the stat tables by g_balance. FxMul by FX_ONE is exact, so normal play is unaffected.
+void ApplyBalanceScales() {
+    for (int type = 0; type < TOWER_TYPE_COUNT; type++) {
+        for (int level = 0; level < MAX_TOWER_LEVEL; level++) {
+            TowerLevelStats *stats = &g_towerStats[type][level];
+            if (type != TOWER_SLOW) stats->damage = FxMul(stats->damage, g_balance.scale[BALANCE_TOWER_DAMAGE]); // Frost "damage" is its slow factor
+            stats->cost = (int)(((int64_t)stats->cost * g_balance.scale[BALANCE_TOWER_COST] + FX_ONE / 2) >> FX_SHIFT);
+        }
+    }
+    for (int type = 0; type < ENEMY_TYPE_COUNT; type++) {
+        enemyTypes[type].maxHealth = FxMul(enemyTypes[type].maxHealth, g_balance.scale[BALANCE_ENEMY_HEALTH]);
+        enemyTypes[type].speed = FxMul(enemyTypes[type].speed, g_balance.scale[BALANCE_ENEMY_SPEED]);
+    }
 }
 
 void LoadGameAudio() {
@@ -254,15 +1032,22 @@ void InitializeGame() {
     gameSpeed = 1.0f;
     g_isPaused = false;
     projectileCount = 0;
+    activeWave.shotCount = 0;
+    ResetKineticSchedule();
+    simTimeAccumulator = 0.0f;
+    simTick = 0;
+    StartTelemetryRun();
 
     for (int x = 0; x < GRID_SIZE; x++) {
         for (int y = 0; y < GRID_SIZE; y++) {
             towers[x][y].active = false;
+            g_towerRotation[x][y] = 0.0f;
         }
     }
     
     InitializeTowerStats();
     InitializeEnemyTypes();
+    ApplyBalanceScales();
 }
 
 void RestartGame() {
@@ -271,10 +1056,12 @@ void RestartGame() {
 
 void CreateWave(int waveNumber) {
     activeWave.enemiesSpawned = 0;
-    activeWave.spawnTimer = 0.0f;
+    activeWave.spawnTimer = 0;
     activeWave.isFinished = false;
+    activeWave.shotCount = 0;
+    ResetKineticSchedule();
 
-    float healthMultiplier = 1.0f + (waveNumber - 1) * 0.20f;
+    fixed_t healthMultiplier = FX_ONE + (waveNumber - 1) * FX(0.20f);
     int enemyTypeCounts[ENEMY_TYPE_COUNT] = {0};
 
     // Hand-crafted waves for the beginning, procedural for the end
@@ -286,7 +1073,7 @@ void CreateWave(int waveNumber) {
     else if (waveNumber == 6) { enemyTypeCounts[ENEMY_NORMAL] = 10; enemyTypeCounts[ENEMY_TANK] = 3; }
     else if (waveNumber == 7) { enemyTypeCounts[ENEMY_NORMAL] = 15; enemyTypeCounts[ENEMY_SCOUT] = 10; enemyTypeCounts[ENEMY_TANK] = 5; }
     else if (waveNumber == 8) { enemyTypeCounts[ENEMY_TANK] = 10; }
-    else if (waveNumber == MAX_WAVES) { enemyTypeCounts[ENEMY_BOSS] = 1; healthMultiplier = 1.0f; }
+    else if (waveNumber == MAX_WAVES) { enemyTypeCounts[ENEMY_BOSS] = 1; healthMultiplier = FX_ONE; }
     else { // Procedural generation for later waves
         enemyTypeCounts[ENEMY_NORMAL] = 10 + waveNumber;
         if (waveNumber > 5) enemyTypeCounts[ENEMY_SCOUT] = 5 + (waveNumber-5)*2;
@@ -299,16 +1086,111 @@ void CreateWave(int waveNumber) {
 
     int currentEnemy = 0;
     for (int type = 0; type < ENEMY_TYPE_COUNT; type++) {
+        activeWave.typeRunStart[type] = currentEnemy;
         for (int i = 0; i < enemyTypeCounts[type]; i++) {
             if (currentEnemy >= activeWave.enemyCount) break;
             activeWave.enemies[currentEnemy].active = false;
             activeWave.enemies[currentEnemy].type = type;
-            activeWave.enemies[currentEnemy].maxHealth = enemyTypes[type].maxHealth * healthMultiplier;
-            activeWave.enemies[currentEnemy].speedMultiplier = 1.0f;
-            activeWave.enemies[currentEnemy].slowTimer = 0.0f;
+            activeWave.enemies[currentEnemy].maxHealth = FxMul(enemyTypes[type].maxHealth, healthMultiplier);
+            activeWave.enemies[currentEnemy].speedMultiplier = FX_ONE;
+            activeWave.enemies[currentEnemy].slowTimer = 0;
             currentEnemy++;
         }
     }
+    activeWave.typeRunStart[ENEMY_TYPE_COUNT] = currentEnemy;
+}
+
+// --- Player Commands ---
+// Every player action that changes sim state goes through ApplyCommand(), so a run is fully
+// described by its map plus the command stream. Validation lives here, feedback sounds in the UI.
+
+int GetTowerSellValue(const Tower *tower) {
+    int sellValue = 0;
+    for (int i = 0; i <= tower->level; i++) sellValue += g_towerStats[tower->type][i].cost;
+    return (int)(sellValue * 0.7f);
+}
+
+bool ApplyCommand(const GameCommand *cmd) {
+    int x = cmd->x, y = cmd->y;
+    bool onGrid = x < GRID_SIZE && y < GRID_SIZE;
+    switch (cmd->type) {
+        case CMD_BUILD_TOWER: {
+            if (!onGrid || cmd->towerType >= TOWER_TYPE_COUNT) return false;
+            if (!walls[x][y] || towers[x][y].active) return false;
+            int cost = g_towerStats[cmd->towerType][0].cost;
+            if (playerMoney < cost) return false;
+            playerMoney -= cost;
+            Tower *newTower = &towers[x][y];
+            newTower->active = true;
+            newTower->center = (FxVec2){FX_INT(x * cellWidth + cellWidth / 2), FX_INT(y * cellHeight + cellHeight / 2)};
+            newTower->type = cmd->towerType;
+            newTower->level = 0;
+            newTower->fireCooldown = 0;
+            newTower->targetIndex = -1;
+            newTower->muzzleFlashTimer = 0;
+            g_towerRotation[x][y] = 0.0f; // Not the angle of whatever stood here before
+            return true;
+        }
+        case CMD_UPGRADE_TOWER: {
+            if (!onGrid || !towers[x][y].active) return false;
+            Tower *tower = &towers[x][y];
+            if (tower->level >= MAX_TOWER_LEVEL - 1) return false;
+            int cost = g_towerStats[tower->type][tower->level + 1].cost;
+            if (playerMoney < cost) return false;
+            playerMoney -= cost;
+            tower->level++;
+            return true;
+        }
+        case CMD_SELL_TOWER: {
+            if (!onGrid || !towers[x][y].active) return false;
+            playerMoney += GetTowerSellValue(&towers[x][y]);
+            towers[x][y].active = false;
+            return true;
+        }
+        case CMD_START_WAVE: {
+            if (gameState != GAME_STATE_WAVE_TRANSITION) return false;
+            currentWaveNumber++;
+            CreateWave(currentWaveNumber);
+            gameState = GAME_STATE_PLAYING;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Applies a command from local input and records it if a replay is being written.
+// Ignored while a replay is being viewed.
+bool IssueCommand(GameCommand cmd) {
+    if (replayViewer.data) return false;
+    if (!ApplyCommand(&cmd)) return false;
+    RecordReplayCommand(&cmd);
+    return true;
+}
+
+// --- Snapshots ---
+
+void CaptureSnapshot(GameSnapshot *snapshot) {
+    memset(snapshot, 0, sizeof(*snapshot));
+    memcpy(snapshot->towers, towers, sizeof(towers));
+    snapshot->wave = activeWave;
+    snapshot->gameState = gameState;
+    snapshot->playerHealth = playerHealth;
+    snapshot->playerMoney = playerMoney;
+    snapshot->currentWaveNumber = currentWaveNumber;
+    snapshot->simTick = simTick;
+}
+
+void RestoreSnapshot(const GameSnapshot *snapshot) {
+    memcpy(towers, snapshot->towers, sizeof(towers));
+    activeWave = snapshot->wave;
+    gameState = snapshot->gameState;
+    playerHealth = snapshot->playerHealth;
+    playerMoney = snapshot->playerMoney;
+    currentWaveNumber = snapshot->currentWaveNumber;
+    simTick = snapshot->simTick;
+    projectileCount = 0;
+    InvalidateEnemyPositions();
+    ResetKineticSchedule(); // Rebuilt from the restored enemies on the next tick
 }
 
 void FireProjectile(Vector2 startPos, Vector2 endPos, Color color, bool isSplash, float splashRadius) {
@@ -323,29 +1205,157 @@ void FireProjectile(Vector2 startPos, Vector2 endPos, Color color, bool isSplash
     }
 }
 
-void UpdateTowers(float dt) {
+// Positions come from GetEnemyPos, so wave must be activeWave
+void BuildEnemyGrid(const EnemyWave *wave) {
+    int cellOf[MAX_ENEMIES_PER_WAVE];
+    memset(enemyGrid.cellStart, 0, sizeof(enemyGrid.cellStart));
+    enemyGrid.count = 0;
+    g_enemyGridEpoch = g_enemyPosEpoch;
+
+    // Counting sort: count enemies per cell, prefix-sum, then scatter
+    for (int i = 0; i < wave->enemyCount; i++) {
+        const Enemy *enemy = &wave->enemies[i];
+        cellOf[i] = -1;
+        if (!enemy->active) continue;
+        FxVec2 pos = GetEnemyPos(i);
+        int cx = (pos.x >> FX_SHIFT) / cellWidth;
+        int cy = (pos.y >> FX_SHIFT) / cellHeight;
+        if (cx < 0) cx = 0; else if (cx >= GRID_SIZE) cx = GRID_SIZE - 1;
+        if (cy < 0) cy = 0; else if (cy >= GRID_SIZE) cy = GRID_SIZE - 1;
+        cellOf[i] = cy * GRID_SIZE + cx;
+        enemyGrid.cellStart[cellOf[i] + 1]++;
+    }
+    for (int c = 0; c < GRID_SIZE * GRID_SIZE; c++) enemyGrid.cellStart[c + 1] += enemyGrid.cellStart[c];
+
+    int fill[GRID_SIZE * GRID_SIZE];
+    memcpy(fill, enemyGrid.cellStart, sizeof(fill));
+    for (int i = 0; i < wave->enemyCount; i++) {
+        if (cellOf[i] < 0) continue;
+        enemyGrid.enemyIndices[fill[cellOf[i]]++] = i;
+        enemyGrid.count++;
+    }
+}
+
+// Returns up to k live enemies within radius of center, nearest first.
+// Enemies whose entry in excluded[] is true are skipped (excluded may be NULL).
+int FindNearestEnemies(FxVec2 center, fixed_t radius, int k, const bool *excluded, int *outIndices) {
+    if (k <= 0) return 0;
+    if (g_enemyGridEpoch != g_enemyPosEpoch) BuildEnemyGrid(&activeWave);
+    if (enemyGrid.count == 0) return 0;
+    if (k > MAX_ENEMIES_PER_WAVE) k = MAX_ENEMIES_PER_WAVE;
+
+    int64_t bestDistSqr[MAX_ENEMIES_PER_WAVE];
+    int found = 0;
+    int64_t radiusSqr = FxSquare(radius);
+    int centerX = (center.x >> FX_SHIFT) / cellWidth;
+    int centerY = (center.y >> FX_SHIFT) / cellHeight;
+    int minCellSize = (cellWidth < cellHeight) ? cellWidth : cellHeight;
+
+    // Visit rings of cells around the center until no closer enemy can exist
+    for (int ring = 0; ring < GRID_SIZE; ring++) {
+        if (ring > 0) {
+            int64_t ringMinDistSqr = FxSquare(FX_INT((ring - 1) * minCellSize)); // Closest any point in this ring can be
+            if (ringMinDistSqr > radiusSqr) break;
+            if (found == k && ringMinDistSqr > bestDistSqr[found - 1]) break;
+        }
+        for (int cy = centerY - ring; cy <= centerY + ring; cy++) {
+            if (cy < 0 || cy >= GRID_SIZE) continue;
+            for (int cx = centerX - ring; cx <= centerX + ring; cx++) {
+                if (cx < 0 || cx >= GRID_SIZE) continue;
+                if (abs(cx - centerX) != ring && abs(cy - centerY) != ring) continue; // Ring border only
+                int cell = cy * GRID_SIZE + cx;
+                for (int e = enemyGrid.cellStart[cell]; e < enemyGrid.cellStart[cell + 1]; e++) {
+                    int index = enemyGrid.enemyIndices[e];
+                    if (!activeWave.enemies[index].active) continue; // Killed since the grid was built
+                    if (excluded && excluded[index]) continue;
+                    int64_t distSqr = FxDistanceSqr(center, GetEnemyPos(index));
+                    if (distSqr > radiusSqr) continue;
+                    if (found == k && distSqr >= bestDistSqr[found - 1]) continue;
+
+                    // Insert into the sorted candidate list, dropping the farthest if full
+                    int slot = (found < k) ? found++ : found - 1;
+                    while (slot > 0 && bestDistSqr[slot - 1] > distSqr) {
+                        bestDistSqr[slot] = bestDistSqr[slot - 1];
+                        outIndices[slot] = outIndices[slot - 1];
+                        slot--;
+                    }
+                    bestDistSqr[slot] = distSqr;
+                    outIndices[slot] = index;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+// Fires a gun or cannon round at the point where it will meet the tower's target
+static void LaunchShot(const Tower *tower, const TowerLevelStats *stats, fixed_t dt) {
+    if (activeWave.shotCount >= MAX_SHOTS) return;
+    const Enemy *target = &activeWave.enemies[tower->targetIndex];
+    fixed_t shotStep = FxMul(tower->type == TOWER_GUN ? GUN_SHOT_SPEED : CANNON_SHOT_SPEED, dt);
+    int ticks = SolveInterceptTicks(target, tower->center, shotStep, dt);
+    FxVec2 aim;
+    if (ticks > 0) {
+        aim = PredictEnemyPosition(target, ticks, dt);
+    } else { // No intercept before the enemy leaves the path; fire where it is
+        aim = GetEnemyPos(tower->targetIndex);
+        int64_t distance = ISqrt64(FxDistanceSqr(tower->center, aim));
+        ticks = (int)((distance + shotStep - 1) / shotStep);
+        if (ticks < 1) ticks = 1;
+    }
+    activeWave.shots[activeWave.shotCount++] = (Shot){tower->center, aim, tower->targetIndex, tower->type, ticks, ticks, stats->damage, stats->splashRadius};
+}
+
+// Lands every round that arrives this tick. Gun rounds hit their target if it is still where
+// they were aimed; cannon rounds damage everything within their splash radius of the aim point.
+void UpdateShots() {
+    for (int i = 0; i < activeWave.shotCount; i++) {
+        Shot *shot = &activeWave.shots[i];
+        if (--shot->ticksLeft > 0) continue;
+        if (shot->towerType == TOWER_GUN) {
+            const Enemy *target = &activeWave.enemies[shot->targetIndex];
+            if (target->active && FxDistanceSqr(GetEnemyPos(shot->targetIndex), shot->to) <= FxSquare(SHOT_HIT_RADIUS)) DamageEnemy(shot->targetIndex, shot->damage);
+        } else {
+            int64_t splashRadiusSqr = FxSquare(shot->splashRadius);
+            for (int e = 0; e < activeWave.enemyCount; e++) {
+                if (activeWave.enemies[e].active && FxDistanceSqr(shot->to, GetEnemyPos(e)) < splashRadiusSqr) DamageEnemy(e, shot->damage);
+            }
+            FireProjectile(FxToVector2(shot->to), FxToVector2(shot->to), COLOR_NEON_ORANGE, true, FxToFloat(shot->splashRadius));
+            PlaySimSound(sndExplosion);
+        }
+        *shot = activeWave.shots[--activeWave.shotCount];
+        i--;
+    }
+    CollectKilledEnemies(&activeWave);
+}
+
+void UpdateTowers(fixed_t dt) {
     for (int x = 0; x < GRID_SIZE; x++) {
         for (int y = 0; y < GRID_SIZE; y++) {
             Tower *tower = &towers[x][y];
             if (!tower->active) continue;
 
             TowerLevelStats stats = g_towerStats[tower->type][tower->level];
+            int64_t rangeSqr = FxSquare(stats.range);
+            int candidates[MAX_ENEMIES_PER_WAVE]; // Enemies inside the tower's coverage; none means the tower sleeps
+            int candidateCount = GetTowerCandidates(x, y, dt, candidates);
             if (tower->fireCooldown > 0) tower->fireCooldown -= dt;
             if (tower->muzzleFlashTimer > 0) tower->muzzleFlashTimer -= dt;
 
             // SLOW TOWER LOGIC (Area of Effect, no target)
             if (tower->type == TOWER_SLOW) {
                 if (tower->fireCooldown <= 0) {
-                    Vector2 towerScreenPos = {(tower->pos.x * cellWidth) + cellWidth / 2.0f, (tower->pos.y * cellHeight) + cellHeight / 2.0f};
-                    for (int i = 0; i < activeWave.enemyCount; i++) {
+                    fixed_t pulseInterval = FxDiv(FX_ONE, stats.fireRate);
+                    for (int c = 0; c < candidateCount; c++) {
+                        int i = candidates[c];
                         Enemy *enemy = &activeWave.enemies[i];
-                        if (!enemy->active) continue;
-                        if (CheckCollisionPointCircle(enemy->pos, towerScreenPos, stats.range)) {
+                        if (FxDistanceSqr(GetEnemyPos(i), tower->center) <= rangeSqr) {
                             enemy->speedMultiplier = stats.damage; // Using damage field for slow %
-                            enemy->slowTimer = 1.0f / stats.fireRate + 0.1f; // Resets every pulse
+                            enemy->slowTimer = pulseInterval + FX(0.1f); // Resets every pulse
+                            RescheduleEnemy(i, dt); // Its boundary crossings move with its speed
                         }
                     }
-                    tower->fireCooldown = 1.0f / stats.fireRate;
+                    tower->fireCooldown = pulseInterval;
                 }
                 continue; // Skip targeting logic for slow tower
             }
@@ -353,21 +1363,20 @@ void UpdateTowers(float dt) {
             // TARGETING LOGIC (Furthest along path)
             if (tower->targetIndex != -1) {
                 Enemy *target = &activeWave.enemies[tower->targetIndex];
-                Vector2 towerScreenPos = {(tower->pos.x * cellWidth) + cellWidth / 2.0f, (tower->pos.y * cellHeight) + cellHeight / 2.0f};
-                if (!target->active || Vector2DistanceSqr(towerScreenPos, target->pos) > (stats.range * stats.range)) {
+                if (!target->active || !IsTowerCandidate(x, y, tower->targetIndex) ||
+                    FxDistanceSqr(tower->center, GetEnemyPos(tower->targetIndex)) > rangeSqr) {
                     tower->targetIndex = -1;
                 }
             }
 
             if (tower->targetIndex == -1) {
-                float maxProgress = -1.0f;
+                fixed_t maxProgress = -1;
                 int bestTargetIndex = -1;
-                Vector2 towerScreenPos = {(tower->pos.x * cellWidth) + cellWidth / 2.0f, (tower->pos.y * cellHeight) + cellHeight / 2.0f};
-                for (int i = 0; i < activeWave.enemyCount; i++) {
+                for (int c = 0; c < candidateCount; c++) {
+                    int i = candidates[c];
                     Enemy *enemy = &activeWave.enemies[i];
-                    if (!enemy->active) continue;
-                    float distanceSqr = Vector2DistanceSqr(towerScreenPos, enemy->pos);
-                    if (distanceSqr <= (stats.range * stats.range) && enemy->progress > maxProgress) {
+                    if (!enemy->active || enemy->progress <= maxProgress) continue;
+                    if (FxDistanceSqr(tower->center, GetEnemyPos(i)) <= rangeSqr) {
                         maxProgress = enemy->progress;
                         bestTargetIndex = i;
                     }
@@ -377,41 +1386,36 @@ void UpdateTowers(float dt) {
             
             // FIRING LOGIC
             if (tower->targetIndex != -1) {
-                Enemy *target = &activeWave.enemies[tower->targetIndex];
-                Vector2 towerScreenPos = {(tower->pos.x * cellWidth) + cellWidth / 2.0f, (tower->pos.y * cellHeight) + cellHeight / 2.0f};
-                
-                // Update turret rotation
-                float angle = atan2f(target->pos.y - towerScreenPos.y, target->pos.x - towerScreenPos.x) * RAD2DEG;
-                tower->rotation = angle;
-                
                 if (tower->fireCooldown <= 0) {
                     if (tower->type == TOWER_GUN) {
-                        target->health -= stats.damage;
-                        FireProjectile(towerScreenPos, target->pos, COLOR_NEON_WHITE, false, 0);
-                        PlaySound(sndLaser);
-                        tower->muzzleFlashTimer = 0.1f;
+                        LaunchShot(tower, &stats, dt);
+                        PlaySimSound(sndLaser);
+                        tower->muzzleFlashTimer = FX(0.1f);
                     } else if (tower->type == TOWER_SPLASH) {
-                        for (int i = 0; i < activeWave.enemyCount; i++) {
-                            Enemy *splashTarget = &activeWave.enemies[i];
-                            if (splashTarget->active && Vector2DistanceSqr(target->pos, splashTarget->pos) < (stats.splashRadius * stats.splashRadius)) {
-                                splashTarget->health -= stats.damage;
-                            }
+                        LaunchShot(tower, &stats, dt); // The explosion and its sound come on impact
+                    } else if (tower->type == TOWER_CHAIN) {
+                        bool alreadyHit[MAX_ENEMIES_PER_WAVE] = {0};
+                        int hitIndex = tower->targetIndex;
+                        FxVec2 arcStart = tower->center;
+                        fixed_t damage = stats.damage;
+                        for (int jump = 0; jump < stats.chainTargets; jump++) {
+                            DamageEnemy(hitIndex, damage);
+                            alreadyHit[hitIndex] = true;
+                            FxVec2 hitPos = GetEnemyPos(hitIndex);
+                            FireProjectile(FxToVector2(arcStart), FxToVector2(hitPos), COLOR_NEON_VIOLET, false, 0);
+                            arcStart = hitPos;
+                            damage = FxMul(damage, CHAIN_DAMAGE_FALLOFF);
+                            if (FindNearestEnemies(arcStart, stats.splashRadius, 1, alreadyHit, &hitIndex) == 0) break;
                         }
-                        FireProjectile(towerScreenPos, target->pos, COLOR_NEON_ORANGE, true, stats.splashRadius);
-                        PlaySound(sndExplosion);
+                        PlaySimSound(sndLaser);
+                        tower->muzzleFlashTimer = FX(0.1f);
                     }
 
-                    tower->fireCooldown = 1.0f / stats.fireRate;
+                    tower->fireCooldown = FxDiv(FX_ONE, stats.fireRate);
 
-                    for (int i = 0; i < activeWave.enemyCount; i++) {
-                        Enemy *enemy = &activeWave.enemies[i];
-                        if (enemy->active && enemy->health <= 0) {
-                            enemy->active = false;
-                            playerMoney += enemyTypes[enemy->type].money;
-                            if (tower->targetIndex == i) {
-                                tower->targetIndex = -1;
-                            }
-                        }
+                    CollectKilledEnemies(&activeWave);
+                    if (!activeWave.enemies[tower->targetIndex].active) {
+                        tower->targetIndex = -1;
                     }
                 }
             }
@@ -419,39 +1423,80 @@ void UpdateTowers(float dt) {
     }
 }
 
-void UpdateWave(EnemyWave *wave, float dt) {
+// Runs after UpdateEnemies so spawns placed mid-step are not advanced a second time
+void UpdateWave(EnemyWave *wave, fixed_t dt) {
     if (wave->enemiesSpawned >= wave->enemyCount) {
         wave->isFinished = true;
         return;
     }
     wave->spawnTimer += dt;
-    if (wave->spawnTimer >= SPAWN_INTERVAL) {
-        wave->spawnTimer = 0;
+
+    // Emit every spawn that fell due during this step, keeping the remainder so spacing never drifts
+    while (wave->spawnTimer >= SPAWN_INTERVAL && wave->enemiesSpawned < wave->enemyCount) {
+        wave->spawnTimer -= SPAWN_INTERVAL;
         Enemy *enemy = &wave->enemies[wave->enemiesSpawned];
         enemy->active = true;
-        enemy->pos = (Vector2){(path[0].x * cellWidth) + cellWidth / 2.0f, (path[0].y * cellHeight) + cellHeight / 2.0f};
-        enemy->pathIndex = 0;
-        enemy->moveTimer = 0.0f;
         enemy->health = enemy->maxHealth;
+        enemy->laneOffset = 0;
+
+        // spawnTimer is now how long ago this spawn was due; place it where it would have walked to
+        fixed_t distance = FxMul(enemyTypes[enemy->type].speed, wave->spawnTimer);
+        enemy->pathIndex = distance >> FX_SHIFT;
+        enemy->segmentProgress = distance & (FX_ONE - 1);
+        if (enemy->pathIndex >= pathLength - 1) {
+            enemy->pathIndex = pathLength - 1;
+            enemy->segmentProgress = 0;
+        }
+        UpdateEnemyProgress(enemy);
         wave->enemiesSpawned++;
     }
 }
 
-void UpdateEnemies(EnemyWave *wave, float dt) {
-    for (int i = 0; i < wave->enemyCount; i++) {
+// --- Per-Archetype Enemy Loops ---
+// One movement loop and one kill sweep per enemy type, generated from ENEMY_ARCHETYPES.
+// Each runs over that type's contiguous run, so speed and money are compile-time
+// constants and the movement step is an integer multiply instead of a table lookup and divide.
+#define DEFINE_ENEMY_RUN_LOOPS(id, name, speed, color, maxHealth, money, radius) \
+static void AdvanceEnemyRun_##name(Enemy *enemies, int begin, int end, fixed_t dt) { \
+    /* Segment fraction covered per tick when not slowed; the same product ApplyBalanceScales stores in enemyTypes */ \
+    const fixed_t fullStep = FxMul(FxMul(FX(speed), g_balance.scale[BALANCE_ENEMY_SPEED]), dt); \
+    for (int i = begin; i < end; i++) { \
+        Enemy *enemy = &enemies[i]; \
+        bool slowed = enemy->slowTimer > 0; \
+        enemy->slowTimer = slowed ? enemy->slowTimer - dt : enemy->slowTimer; \
+        enemy->speedMultiplier = slowed ? enemy->speedMultiplier : FX_ONE; \
+        enemy->segmentProgress += enemy->active ? FxMul(fullStep, enemy->speedMultiplier) : 0; \
+    } \
+} \
+static int CollectKilledRun_##name(Enemy *enemies, int begin, int end) { \
+    int killed = 0; \
+    for (int i = begin; i < end; i++) { \
+        bool dies = enemies[i].active && enemies[i].health <= 0; \
+        enemies[i].active = enemies[i].active && !dies; \
+        killed += dies; \
+    } \
+    return killed * (money); \
+}
+ENEMY_ARCHETYPES(DEFINE_ENEMY_RUN_LOOPS)
+#undef DEFINE_ENEMY_RUN_LOOPS
+
+void UpdateEnemies(EnemyWave *wave, fixed_t dt) {
+    // Only spawned enemies can be active, so clip each run to the spawned prefix
+#define X(id, name, speed, color, maxHealth, money, radius) \
+    AdvanceEnemyRun_##name(wave->enemies, wave->typeRunStart[id], \
+                           wave->typeRunStart[id + 1] < wave->enemiesSpawned ? wave->typeRunStart[id + 1] : wave->enemiesSpawned, dt);
+    ENEMY_ARCHETYPES(X)
+#undef X
+
+    // Node transitions and leaks are type-independent
+    for (int i = 0; i < wave->enemiesSpawned; i++) {
         Enemy *enemy = &wave->enemies[i];
         if (!enemy->active) continue;
 
-        if (enemy->slowTimer > 0) {
-            enemy->slowTimer -= dt;
-        } else {
-            enemy->speedMultiplier = 1.0f;
-        }
-
         if (enemy->pathIndex >= pathLength - 1) {
             enemy->active = false;
             playerHealth--;
-            PlaySound(sndHurt);
+            PlaySimSound(sndHurt);
             if (playerHealth <= 0) {
                 playerHealth = 0;
                 gameState = GAME_STATE_GAME_OVER;
@@ -459,49 +1504,563 @@ void UpdateEnemies(EnemyWave *wave, float dt) {
             continue;
         }
 
-        float effectiveSpeed = enemyTypes[enemy->type].speed * enemy->speedMultiplier;
-        float moveInterval = 1.0f / effectiveSpeed;
-        enemy->moveTimer += dt;
-
-        Vector2 startNode = path[enemy->pathIndex];
-        Vector2 targetNode = path[enemy->pathIndex + 1];
-        Vector2 startScreenPos = {startNode.x * cellWidth + cellWidth / 2.0f, startNode.y * cellHeight + cellHeight / 2.0f};
-        Vector2 targetScreenPos = {targetNode.x * cellWidth + cellWidth / 2.0f, targetNode.y * cellHeight + cellHeight / 2.0f};
-
-        float lerpAmount = (moveInterval > 0) ? (enemy->moveTimer / moveInterval) : 1.0f;
-        if (lerpAmount >= 1.0f) {
-            lerpAmount = 1.0f;
+        // Large steps can cross several nodes at once
+        while (enemy->segmentProgress >= FX_ONE && enemy->pathIndex < pathLength - 1) {
+            enemy->segmentProgress -= FX_ONE;
             enemy->pathIndex++;
-            enemy->moveTimer -= moveInterval;
         }
-        
-        enemy->pos = Vector2Lerp(startScreenPos, targetScreenPos, lerpAmount);
-        enemy->progress = (float)enemy->pathIndex + lerpAmount;
+        UpdateEnemyProgress(enemy);
     }
+    SpreadEnemyLanes(wave);
 }
 
-void CheckWaveCompletion() {
-    if (!activeWave.isFinished) return;
-    
-    for (int i = 0; i < activeWave.enemyCount; i++) {
-        if (activeWave.enemies[i].active) return;
-    }
+// Sideways direction at a point on the path. Within half a segment of a node it blends toward the
+// neighbouring segment's normal, so lane offsets swing smoothly around corners instead of jumping.
+static FxVec2 GetLaneNormal(int segment, fixed_t t) {
+    if (pathLength < 2) return (FxVec2){0, 0};
+    if (segment > pathLength - 2) segment = pathLength - 2;
+    bool early = t < FX_ONE / 2;
+    int neighbor = early ? (segment > 0 ? segment - 1 : segment) : (segment < pathLength - 2 ? segment + 1 : segment);
+    return FxVec2Lerp(pathNormals[segment], pathNormals[neighbor], early ? FX_ONE / 2 - t : t - FX_ONE / 2);
+}
 
-    if (currentWaveNumber >= MAX_WAVES) {
-        gameState = GAME_STATE_VICTORY;
-        return;
+// Derives path progress from pathIndex and segmentProgress
+void UpdateEnemyProgress(Enemy *enemy) {
+    fixed_t lerpAmount = (enemy->segmentProgress < FX_ONE) ? enemy->segmentProgress : FX_ONE;
+    enemy->progress = FX_INT(enemy->pathIndex) + lerpAmount;
+}
+
+// --- Path Prediction ---
+// Where an enemy will be, without stepping the sim. Between slow changes an enemy's path
+// distance grows by a fixed step per tick, so the distance after k ticks is closed form; the
+// path polyline and lane offset map it to a position. Intercepts solve |D + V t| = c (t0 + t)
+// for each straight, constant-speed piece of the enemy's route, in integer math so every
+// machine picks the same aim point, and round the hit time up to whole ticks.
+
+#define LEAD_POS_SHIFT 12  // Q16.16 pixels to Q4 for the intercept quadratic, which keeps it in int64
+#define LEAD_MAX_TICKS 240 // Give up on intercepts further out than this
+#define LEAD_MAX_PIECES 32
+
+// Maps a path distance in nodes, plus a lane offset, to a screen position
+FxVec2 GetPathPosition(fixed_t distance, fixed_t laneOffset) {
+    int index = distance >> FX_SHIFT;
+    fixed_t t = distance & (FX_ONE - 1);
+    if (index >= pathLength - 1) {
+        index = pathLength - 1;
+        t = 0;
     }
+    FxVec2 startNode = pathPoints[index];
+    FxVec2 targetNode = (index < pathLength - 1) ? pathPoints[index + 1] : startNode;
+    FxVec2 normal = GetLaneNormal(index, t);
+    FxVec2 pos = FxVec2Lerp(startNode, targetNode, t);
+    pos.x += FxMul(normal.x, laneOffset);
+    pos.y += FxMul(normal.y, laneOffset);
+    return pos;
+}
 
-    gameState = GAME_STATE_WAVE_TRANSITION;
+// Ticks the enemy's current slow still lasts
+static int GetSlowTicks(const Enemy *enemy, fixed_t dt) {
+    return enemy->slowTimer > 0 ? (enemy->slowTimer + dt - 1) / dt : 0;
 }
 
-void HandleInput() {
-    // Pause Toggle
-    if (IsKeyPressed(KEY_P)) {
-        g_isPaused = !g_isPaused;
+// pathIndex plus segmentProgress after `ticks` more steps, without stopping at the last node
+static int64_t PredictRawDistance(const Enemy *enemy, int ticks, fixed_t dt) {
+    fixed_t fullStep = FxMul(enemyTypes[enemy->type].speed, dt);
+    int slowTicks = GetSlowTicks(enemy, dt);
+    int slowed = ticks < slowTicks ? ticks : slowTicks;
+    return FX_INT(enemy->pathIndex) + (int64_t)enemy->segmentProgress
+         + (int64_t)slowed * FxMul(fullStep, enemy->speedMultiplier) + (int64_t)(ticks - slowed) * fullStep;
+}
+
+// Path distance after `ticks` more sim steps of `dt`, assuming the current slow runs out undisturbed
+fixed_t PredictEnemyDistance(const Enemy *enemy, int ticks, fixed_t dt) {
+    int64_t distance = PredictRawDistance(enemy, ticks, dt);
+    return distance < FX_INT(pathLength - 1) ? (fixed_t)distance : FX_INT(pathLength - 1);
+}
+
+// Inverse of PredictEnemyDistance: the fewest ticks until the enemy is at or past distance,
+// or -1 if it leaves the path first
+int64_t TicksToReachDistance(const Enemy *enemy, fixed_t distance, fixed_t dt) {
+    int64_t need = (int64_t)distance - enemy->progress;
+    if (need <= 0) return 0;
+    if (distance > FX_INT(pathLength - 1)) return -1;
+    fixed_t fullStep = FxMul(enemyTypes[enemy->type].speed, dt);
+    fixed_t slowStep = FxMul(fullStep, enemy->speedMultiplier);
+    int64_t slowTicks = GetSlowTicks(enemy, dt);
+    int64_t slowReach = slowTicks * slowStep;
+    if (need <= slowReach) return (need + slowStep - 1) / slowStep;
+    if (fullStep <= 0) return -1;
+    return slowTicks + (need - slowReach + fullStep - 1) / fullStep;
+}
+
+FxVec2 PredictEnemyPosition(const Enemy *enemy, int ticks, fixed_t dt) {
+    return GetPathPosition(PredictEnemyDistance(enemy, ticks, dt), enemy->laneOffset);
+}
+
+// Smallest root of a t^2 + b t + k in [0, limit], in Q8 ticks, or -1
+static int64_t SmallestRootInRange(int64_t a, int64_t b, int64_t k, int64_t limit) {
+    int64_t roots[2];
+    int count = 0;
+    if (a == 0) {
+        if (b != 0) roots[count++] = (-k * 256) / b;
+    } else {
+        int64_t disc = b * b - 4 * a * k;
+        if (disc < 0) return -1;
+        int64_t s = ISqrt64(disc);
+        roots[count++] = ((-b - s) * 256) / (2 * a);
+        roots[count++] = ((-b + s) * 256) / (2 * a);
     }
-    
-    // Fast Forward Toggle
+    int64_t best = -1;
+    for (int i = 0; i < count; i++) {
+        if (roots[i] >= 0 && roots[i] <= limit && (best < 0 || roots[i] < best)) best = roots[i];
+    }
+    return best;
+}
+
+// Ticks until a shot from `from` moving shotStep pixels per tick meets the enemy, or -1 if it
+// cannot before the enemy leaves the path or LEAD_MAX_TICKS pass
+int SolveInterceptTicks(const Enemy *enemy, FxVec2 from, fixed_t shotStep, fixed_t dt) {
+    fixed_t fullStep = FxMul(enemyTypes[enemy->type].speed, dt);
+    fixed_t slowStep = FxMul(fullStep, enemy->speedMultiplier);
+    int64_t slowEnd = (int64_t)GetSlowTicks(enemy, dt) << 8; // Q8 ticks
+    fixed_t distance = FX_INT(enemy->pathIndex) + enemy->segmentProgress;
+    int64_t c = shotStep >> LEAD_POS_SHIFT;
+    int64_t t0 = 0; // Q8 ticks at the start of the piece
+
+    for (int piece = 0; piece < LEAD_MAX_PIECES && distance < FX_INT(pathLength - 1) && t0 <= LEAD_MAX_TICKS << 8; piece++) {
+        bool slowed = t0 < slowEnd;
+        fixed_t step = slowed ? slowStep : fullStep;
+        if (step <= 0) return -1;
+        int segment = distance >> FX_SHIFT;
+        int64_t length = ((((int64_t)FX_INT(segment + 1) - distance) << 8) + step - 1) / step;
+        bool endsAtNode = !slowed || length <= slowEnd - t0;
+        if (!endsAtNode) length = slowEnd - t0;
+
+        FxVec2 start = GetPathPosition(distance, enemy->laneOffset);
+        int64_t dx = ((int64_t)start.x - from.x) >> LEAD_POS_SHIFT, dy = ((int64_t)start.y - from.y) >> LEAD_POS_SHIFT;
+        int64_t v = ((int64_t)step * cellWidth) >> LEAD_POS_SHIFT;
+        int64_t vx = pathPoints[segment + 1].x > pathPoints[segment].x ? v : pathPoints[segment + 1].x < pathPoints[segment].x ? -v : 0;
+        int64_t vy = pathPoints[segment + 1].y > pathPoints[segment].y ? v : pathPoints[segment + 1].y < pathPoints[segment].y ? -v : 0;
+        int64_t a = vx * vx + vy * vy - c * c;
+        int64_t b = 2 * (dx * vx + dy * vy) - (2 * c * c * t0) / 256;
+        int64_t k = dx * dx + dy * dy - (c * c * t0 * t0) / 65536;
+        int64_t tau = SmallestRootInRange(a, b, k, length);
+        if (tau >= 0) {
+            int ticks = (int)((t0 + tau + 255) >> 8);
+            return ticks > 0 ? ticks : 1;
+        }
+
+        distance = endsAtNode ? FX_INT(segment + 1) : distance + (fixed_t)(((int64_t)step * length) >> 8);
+        t0 += length;
+    }
+    return -1;
+}
+
+// --- Lane Spreading ---
+// Live enemies are ordered by path distance each tick: a counting sort on the path node, then an
+// insertion sort inside each node. Buckets are filled in descending index order, which for a
+// stream of one type (earlier spawns are further ahead) is already ascending progress, so the
+// insertion sort only ever moves a few entries. Each enemy is then checked
+// against the next few enemies in that order; any within LANE_SPACING along the path and closer
+// than LANE_MIN_GAP sideways are pushed apart, within LANE_HALF_WIDTH of the centerline. Bounded
+// neighbour counts keep the pass O(n), and the fixed visiting order keeps it deterministic.
+
+#define LANE_HALF_WIDTH FX(cellWidth / 4.0f)
+#define LANE_MIN_GAP FX(12.0f)
+#define LANE_SPACING FX(0.3f)     // In path nodes
+#define LANE_PUSH FX(0.25f)       // Fraction of the overlap corrected per tick
+#define LANE_NEIGHBORS 4
+
+void SpreadEnemyLanes(EnemyWave *wave) {
+    if (pathLength == 0) return;
+    int order[MAX_ENEMIES_PER_WAVE];
+    int nodeStart[GRID_SIZE * GRID_SIZE + 1] = {0};
+    int count = 0;
+    for (int i = 0; i < wave->enemiesSpawned; i++) {
+        if (wave->enemies[i].active) nodeStart[wave->enemies[i].pathIndex + 1]++;
+    }
+    for (int n = 0; n < pathLength; n++) nodeStart[n + 1] += nodeStart[n];
+    for (int i = wave->enemiesSpawned - 1; i >= 0; i--) {
+        if (wave->enemies[i].active) order[nodeStart[wave->enemies[i].pathIndex]++] = i;
+    }
+    count = nodeStart[pathLength - 1]; // Each start has advanced to the next node's, so this is the end
+    for (int i = 1; i < count; i++) {
+        int index = order[i], j = i;
+        fixed_t progress = wave->enemies[index].progress;
+        // Ties by index, so the order does not depend on how the buckets were filled
+        while (j > 0 && (wave->enemies[order[j - 1]].progress > progress ||
+                         (wave->enemies[order[j - 1]].progress == progress && order[j - 1] > index))) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = index;
+    }
+
+    for (int i = 0; i < count; i++) {
+        Enemy *a = &wave->enemies[order[i]];
+        for (int k = 1; k <= LANE_NEIGHBORS && i + k < count; k++) {
+            Enemy *b = &wave->enemies[order[i + k]];
+            if (b->progress - a->progress >= LANE_SPACING) break;
+            fixed_t apart = b->laneOffset - a->laneOffset;
+            fixed_t distance = apart < 0 ? -apart : apart;
+            if (distance >= LANE_MIN_GAP) continue;
+            // Coincident enemies split by index, so the push direction never depends on rounding
+            fixed_t push = FxMul(LANE_MIN_GAP - distance, LANE_PUSH) / 2;
+            if (apart < 0 || (apart == 0 && order[i + k] < order[i])) push = -push;
+            a->laneOffset = FxClamp(a->laneOffset - push, -LANE_HALF_WIDTH, LANE_HALF_WIDTH);
+            b->laneOffset = FxClamp(b->laneOffset + push, -LANE_HALF_WIDTH, LANE_HALF_WIDTH);
+        }
+    }
+}
+
+// --- Enemy Positions ---
+// The sim only advances path distance. A screen position is built the first time something asks
+// for it in a tick (a range check, a splash, the neighbor grid, the renderer) and reused until
+// enemies move again, so enemies nobody looks at never pay for the path lookup.
+
+FxVec2 GetEnemyPos(int index) {
+    if (g_enemyPosStamp[index] != g_enemyPosEpoch) {
+        const Enemy *enemy = &activeWave.enemies[index];
+        g_enemyPosCache[index] = GetPathPosition(enemy->progress, enemy->laneOffset);
+        g_enemyPosStamp[index] = g_enemyPosEpoch;
+    }
+    return g_enemyPosCache[index];
+}
+
+// Called whenever enemy progress or lanes may have changed: each tick, and when state is restored
+void InvalidateEnemyPositions() {
+    g_enemyPosEpoch++;
+}
+
+// --- Tower Coverage ---
+// Each path segment is a straight line, so the part of it within a tower's range is one chord
+// of the range circle. Widening the circle by the lane half-width makes the intervals hold for
+// every lane. Intervals are rounded outward and cached until the tower, its range or the path changes.
+
+static void ComputeTowerCoverage(const Tower *tower, fixed_t range, TowerCoverage *coverage) {
+    coverage->count = 0;
+    int64_t reachSqr = FxSquare(range + LANE_HALF_WIDTH);
+    for (int i = 0; i + 1 < pathLength; i++) {
+        FxVec2 normal = pathNormals[i];
+        int dirX = normal.y >> FX_SHIFT, dirY = -normal.x >> FX_SHIFT;
+        int64_t offsetX = (int64_t)tower->center.x - pathPoints[i].x, offsetY = (int64_t)tower->center.y - pathPoints[i].y;
+        int64_t along = dirX * offsetX + dirY * offsetY; // Q16.16 pixels from the segment start
+        int64_t across = (-dirY) * offsetX + dirX * offsetY;
+        int64_t chordSqr = reachSqr - across * across;
+        if (chordSqr < 0) continue;
+        int64_t halfChord = ISqrt64(chordSqr) + 1;
+        int64_t lo = along - halfChord, hi = along + halfChord;
+        if (hi < 0 || lo > FX_INT(cellWidth)) continue;
+        if (lo < 0) lo = 0;
+        if (hi > FX_INT(cellWidth)) hi = FX_INT(cellWidth);
+        fixed_t start = FX_INT(i) + (fixed_t)(lo / cellWidth);
+        fixed_t end = FX_INT(i) + (fixed_t)((hi + cellWidth - 1) / cellWidth);
+
+        PathInterval *last = coverage->count > 0 ? &coverage->intervals[coverage->count - 1] : NULL;
+        if (last && (start <= last->end || coverage->count == MAX_COVERAGE_INTERVALS)) {
+            last->end = end; // Touching, or out of slots: widen rather than drop
+        } else {
+            coverage->intervals[coverage->count++] = (PathInterval){start, end};
+        }
+    }
+    coverage->range = range;
+    coverage->pathGeneration = g_pathGeneration;
+    coverage->version = ++g_coverageVersion;
+}
+
+const TowerCoverage *GetTowerCoverage(int x, int y) {
+    const Tower *tower = &towers[x][y];
+    TowerCoverage *coverage = &g_towerCoverage[x][y];
+    fixed_t range = g_towerStats[tower->type][tower->level].range;
+    if (coverage->range != range || coverage->pathGeneration != g_pathGeneration) ComputeTowerCoverage(tower, range, coverage);
+    return coverage;
+}
+
+bool IsInCoverage(const TowerCoverage *coverage, fixed_t progress) {
+    for (int i = 0; i < coverage->count; i++) {
+        if (progress >= coverage->intervals[i].start && progress <= coverage->intervals[i].end) return true;
+    }
+    return false;
+}
+
+// --- Kinetic Scheduling ---
+// Between slow changes an enemy's path distance grows by a fixed step per tick, so the tick at
+// which it next crosses any armed tower's coverage boundary is known in advance. Each live enemy
+// has one pending event for that crossing; when it comes due, the enemy's membership in every
+// tower's coverage set is refreshed and its next crossing scheduled. Towers only scan the enemies
+// in their set, and a tower with an empty set does no targeting work at all. A slow changes the
+// enemy's speed, so it reschedules the enemy; the superseded event is dropped when it surfaces.
+// None of this is sim state: it is rebuilt lazily after a reset or a restore.
+
+static bool KineticEventBefore(const KineticEvent *a, const KineticEvent *b) {
+    return a->tick < b->tick || (a->tick == b->tick && a->enemyIndex < b->enemyIndex);
+}
+
+static void RebuildKineticQueue(fixed_t dt);
+
+static void PushKineticEvent(KineticEvent event, fixed_t dt) {
+    if (g_kinetic.eventCount == MAX_KINETIC_EVENTS) RebuildKineticQueue(dt); // Full of stale events
+    int slot = g_kinetic.eventCount++;
+    while (slot > 0 && KineticEventBefore(&event, &g_kinetic.heap[(slot - 1) / 2])) {
+        g_kinetic.heap[slot] = g_kinetic.heap[(slot - 1) / 2];
+        slot = (slot - 1) / 2;
+    }
+    g_kinetic.heap[slot] = event;
+}
+
+static KineticEvent PopKineticEvent() {
+    KineticEvent top = g_kinetic.heap[0];
+    KineticEvent last = g_kinetic.heap[--g_kinetic.eventCount];
+    int slot = 0;
+    for (;;) {
+        int child = slot * 2 + 1;
+        if (child >= g_kinetic.eventCount) break;
+        if (child + 1 < g_kinetic.eventCount && KineticEventBefore(&g_kinetic.heap[child + 1], &g_kinetic.heap[child])) child++;
+        if (!KineticEventBefore(&g_kinetic.heap[child], &last)) break;
+        g_kinetic.heap[slot] = g_kinetic.heap[child];
+        slot = child;
+    }
+    g_kinetic.heap[slot] = last;
+    return top;
+}
+
+// Queues the enemy's next boundary crossing, superseding any pending one
+void RescheduleEnemy(int index, fixed_t dt) {
+    const Enemy *enemy = &activeWave.enemies[index];
+    uint32_t version = ++g_kinetic.enemyVersion[index];
+    int lo = 0, hi = g_kinetic.boundaryCount;
+    while (lo < hi) { // First boundary strictly ahead
+        int mid = (lo + hi) / 2;
+        if (g_kinetic.boundaries[mid] <= enemy->progress) lo = mid + 1; else hi = mid;
+    }
+    if (lo == g_kinetic.boundaryCount) return;
+    int64_t ticks = TicksToReachDistance(enemy, g_kinetic.boundaries[lo], dt);
+    if (ticks < 0) return; // Leaks first
+    PushKineticEvent((KineticEvent){g_kinetic.now + ticks, index, version}, dt);
+}
+
+static void RebuildKineticQueue(fixed_t dt) {
+    g_kinetic.eventCount = 0;
+    for (int i = 0; i < g_kinetic.scheduledSpawns; i++) {
+        if (activeWave.enemies[i].active) RescheduleEnemy(i, dt);
+    }
+}
+
+static void RefreshEnemyCoverage(int index) {
+    fixed_t progress = activeWave.enemies[index].progress;
+    uint64_t bit = 1ULL << (index % 64);
+    for (int a = 0; a < g_kinetic.armedCount; a++) {
+        int x = g_kinetic.armedCells[a] / GRID_SIZE, y = g_kinetic.armedCells[a] % GRID_SIZE;
+        uint64_t *word = &g_kinetic.inside[x][y][index / 64];
+        *word = IsInCoverage(&g_towerCoverage[x][y], progress) ? (*word | bit) : (*word & ~bit);
+    }
+}
+
+static int CompareFixed(const void *a, const void *b) {
+    fixed_t l = *(const fixed_t *)a, r = *(const fixed_t *)b;
+    return (l > r) - (l < r);
+}
+
+// Starts tracking a tower's coverage, or picks up a recomputed one
+static void ArmTower(int x, int y, const TowerCoverage *coverage, fixed_t dt) {
+    if (g_kinetic.armedVersion[x][y] == 0) g_kinetic.armedCells[g_kinetic.armedCount++] = x * GRID_SIZE + y;
+    g_kinetic.armedVersion[x][y] = coverage->version;
+    memset(g_kinetic.inside[x][y], 0, sizeof(g_kinetic.inside[x][y]));
+    for (int i = 0; i < g_kinetic.scheduledSpawns; i++) {
+        if (activeWave.enemies[i].active && IsInCoverage(coverage, activeWave.enemies[i].progress)) {
+            g_kinetic.inside[x][y][i / 64] |= 1ULL << (i % 64);
+        }
+    }
+
+    // An interval [start, end] is entered at start and left at end plus the smallest step
+    int count = 0;
+    for (int a = 0; a < g_kinetic.armedCount; a++) {
+        const TowerCoverage *armed = &g_towerCoverage[g_kinetic.armedCells[a] / GRID_SIZE][g_kinetic.armedCells[a] % GRID_SIZE];
+        for (int i = 0; i < armed->count; i++) {
+            g_kinetic.boundaries[count++] = armed->intervals[i].start;
+            g_kinetic.boundaries[count++] = armed->intervals[i].end + 1;
+        }
+    }
+    qsort(g_kinetic.boundaries, count, sizeof(fixed_t), CompareFixed);
+    g_kinetic.boundaryCount = 0;
+    for (int i = 0; i < count; i++) {
+        if (i == 0 || g_kinetic.boundaries[i] != g_kinetic.boundaries[i - 1]) g_kinetic.boundaries[g_kinetic.boundaryCount++] = g_kinetic.boundaries[i];
+    }
+    RebuildKineticQueue(dt); // New boundaries can come before any pending crossing
+}
+
+void ResetKineticSchedule() {
+    g_kinetic.eventCount = 0;
+    g_kinetic.armedCount = 0;
+    g_kinetic.boundaryCount = 0;
+    g_kinetic.scheduledSpawns = 0;
+    memset(g_kinetic.armedVersion, 0, sizeof(g_kinetic.armedVersion));
+}
+
+// Runs once enemies have moved and spawned: picks up new spawns and every crossing due this tick
+void AdvanceKineticSchedule(fixed_t dt) {
+    g_kinetic.now = simTick;
+    for (; g_kinetic.scheduledSpawns < activeWave.enemiesSpawned; g_kinetic.scheduledSpawns++) {
+        int index = g_kinetic.scheduledSpawns;
+        if (!activeWave.enemies[index].active) continue;
+        RefreshEnemyCoverage(index);
+        RescheduleEnemy(index, dt);
+    }
+    while (g_kinetic.eventCount > 0 && g_kinetic.heap[0].tick <= g_kinetic.now) {
+        KineticEvent event = PopKineticEvent();
+        if (event.version != g_kinetic.enemyVersion[event.enemyIndex] || !activeWave.enemies[event.enemyIndex].active) continue;
+        RefreshEnemyCoverage(event.enemyIndex);
+        RescheduleEnemy(event.enemyIndex, dt);
+    }
+}
+
+// Live enemies inside the tower's coverage, in index order. Arms the tower first if needed.
+int GetTowerCandidates(int x, int y, fixed_t dt, int *outIndices) {
+    const TowerCoverage *coverage = GetTowerCoverage(x, y);
+    if (g_kinetic.armedVersion[x][y] != coverage->version) ArmTower(x, y, coverage, dt);
+    int count = 0;
+    for (int w = 0; w < ENEMY_BITSET_WORDS; w++) {
+        uint64_t bits = g_kinetic.inside[x][y][w];
+        while (bits) {
+            int index = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            if (activeWave.enemies[index].active) {
+                outIndices[count++] = index;
+            } else {
+                g_kinetic.inside[x][y][w] &= ~(1ULL << (index % 64)); // Killed or leaked
+            }
+        }
+    }
+    return count;
+}
+
+bool IsTowerCandidate(int x, int y, int index) {
+    return (g_kinetic.inside[x][y][index / 64] >> (index % 64)) & 1;
+}
+
+void CollectKilledEnemies(EnemyWave *wave) {
+#define X(id, name, speed, color, maxHealth, money, radius) \
+    playerMoney += CollectKilledRun_##name(wave->enemies, wave->typeRunStart[id], wave->typeRunStart[id + 1]);
+    ENEMY_ARCHETYPES(X)
+#undef X
+}
+
+void CheckWaveCompletion() {
+    if (!activeWave.isFinished) return;
+    
+    for (int i = 0; i < activeWave.enemyCount; i++) {
+        if (activeWave.enemies[i].active) return;
+    }
+
+    if (currentWaveNumber >= MAX_WAVES) {
+        gameState = GAME_STATE_VICTORY;
+        return;
+    }
+
+    gameState = GAME_STATE_WAVE_TRANSITION;
+}
+
+// --- UI Layout ---
+// Widget rectangles depend only on game state, so the input pass and the draw pass each lay the
+// panel out and agree on where everything is. Clicks are resolved in HandleInput, before the
+// frame's sim ticks, and can be driven without a window through HitTestUI/ActivateUIElement.
+
+static void AddUIElement(UiLayout *layout, UiElementKind kind, int index, Rectangle bounds) {
+    layout->elements[layout->count++] = (UiElement){kind, index, bounds};
+}
+
+// The selected tower's stat lines, with the next level's values unless it is maxed. LayoutGameUI
+// sizes the stats panel from the same list DrawSelectionUI draws, so the buttons below it line up.
+static int FormatTowerStatLines(const Tower *tower, char lines[MAX_TOWER_STAT_LINES][64]) {
+    bool isMaxLevel = tower->level >= MAX_TOWER_LEVEL - 1;
+    TowerLevelStats current = g_towerStats[tower->type][tower->level];
+    TowerLevelStats next = isMaxLevel ? current : g_towerStats[tower->type][tower->level + 1];
+    char upgrade[32] = "";
+    int count = 0;
+
+    if (!isMaxLevel) snprintf(upgrade, sizeof(upgrade), "-> %.0f", FxToFloat(next.range));
+    snprintf(lines[count++], 64, "Range: %.0f %s", FxToFloat(current.range), upgrade);
+    if (tower->type == TOWER_SLOW) {
+        if (!isMaxLevel) snprintf(upgrade, sizeof(upgrade), "-> %d%%", 100 - (int)(next.damage * 100 / FX_ONE));
+        snprintf(lines[count++], 64, "Slow: %d%% %s", 100 - (int)(current.damage * 100 / FX_ONE), upgrade);
+    } else {
+        if (!isMaxLevel) snprintf(upgrade, sizeof(upgrade), "-> %.0f", FxToFloat(next.damage));
+        snprintf(lines[count++], 64, "Damage: %.0f %s", FxToFloat(current.damage), upgrade);
+    }
+    if (tower->type == TOWER_CHAIN) {
+        if (!isMaxLevel) snprintf(upgrade, sizeof(upgrade), "-> %d", next.chainTargets);
+        snprintf(lines[count++], 64, "Jumps: %d %s", current.chainTargets, upgrade);
+    }
+    if (!isMaxLevel) snprintf(upgrade, sizeof(upgrade), "-> %.1f/s", FxToFloat(next.fireRate));
+    snprintf(lines[count++], 64, "Fire Rate: %.1f/s %s", FxToFloat(current.fireRate), upgrade);
+    return count;
+}
+
+void LayoutGameUI(UiLayout *layout) {
+    int uiX = GAME_AREA_WIDTH + 15;
+    layout->count = 0;
+    if (g_selectedTowerX != -1) {
+        const Tower *tower = &towers[g_selectedTowerX][g_selectedTowerY];
+        char lines[MAX_TOWER_STAT_LINES][64];
+        Rectangle stats = {uiX, 180, 170, UI_STATS_HEADER_HEIGHT + FormatTowerStatLines(tower, lines) * UI_STAT_LINE_HEIGHT};
+        AddUIElement(layout, UI_TOWER_STATS, 0, stats);
+        int yPos = stats.y + stats.height + UI_STATS_GAP;
+        if (tower->level < MAX_TOWER_LEVEL - 1) AddUIElement(layout, UI_UPGRADE, 0, (Rectangle){uiX, yPos, 170, 40});
+        AddUIElement(layout, UI_SELL, 0, (Rectangle){uiX, yPos + 50, 170, 40});
+    } else {
+        for (int i = 0; i < TOWER_TYPE_COUNT; i++) {
+            AddUIElement(layout, UI_SELECT_BUILD, i, (Rectangle){uiX - 5, 210 + i * 90, 180, 80});
+        }
+    }
+    if (gameState == GAME_STATE_WAVE_TRANSITION) {
+        AddUIElement(layout, UI_START_WAVE, 0, (Rectangle){GAME_AREA_WIDTH + 15, SCREEN_HEIGHT - 70, 170, 50});
+    }
+}
+
+const UiElement *FindUIElement(const UiLayout *layout, UiElementKind kind, int index) {
+    for (int i = 0; i < layout->count; i++) {
+        if (layout->elements[i].kind == kind && layout->elements[i].index == index) return &layout->elements[i];
+    }
+    return NULL;
+}
+
+const UiElement *HitTestUI(const UiLayout *layout, Vector2 point) {
+    for (int i = 0; i < layout->count; i++) {
+        if (CheckCollisionPointRec(point, layout->elements[i].bounds)) return &layout->elements[i];
+    }
+    return NULL;
+}
+
+void ActivateUIElement(const UiElement *element) {
+    switch (element->kind) {
+        case UI_START_WAVE:
+            IssueCommand((GameCommand){CMD_START_WAVE, 0, 0, 0});
+            break;
+        case UI_SELECT_BUILD:
+            if (playerMoney >= g_towerStats[element->index][0].cost) {
+                g_selectedBuildType = element->index;
+                g_selectedTowerX = -1; g_selectedTowerY = -1;
+            } else {
+                PlaySound(sndError);
+            }
+            break;
+        case UI_UPGRADE: UpgradeSelectedTower(); break;
+        case UI_SELL: SellSelectedTower(); break;
+        default: break;
+    }
+}
+
+static bool IsUIElementHovered(UiElementKind kind, int index) {
+    return g_uiHovered.kind == kind && g_uiHovered.index == index;
+}
+
+void HandleInput() {
+    // Pause Toggle
+    if (IsKeyPressed(KEY_P)) {
+        g_isPaused = !g_isPaused;
+    }
+    
+    // Fast Forward Toggle
     if (IsKeyPressed(KEY_F)) {
         gameSpeed = (gameSpeed == 1.0f) ? 2.0f : 1.0f;
     }
@@ -518,27 +2077,24 @@ void HandleInput() {
     int gridY = (int)(mousePos.y / cellHeight);
     bool isMouseOnGameArea = (mousePos.x < GAME_AREA_WIDTH && mousePos.x > 0);
 
+    // Panel widgets
+    UiLayout layout;
+    LayoutGameUI(&layout);
+    const UiElement *hit = HitTestUI(&layout, mousePos);
+    g_uiHovered = hit ? *hit : (UiElement){UI_NONE};
+    if (hit && IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
+        ActivateUIElement(hit);
+        LayoutGameUI(&layout); // The click may have swapped panels
+        hit = HitTestUI(&layout, mousePos);
+        g_uiHovered = hit ? *hit : (UiElement){UI_NONE};
+    }
+
     // Tower Placement / Selection
     if (isMouseOnGameArea && IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
         if (g_selectedBuildType != -1) { // Trying to build
-            if (walls[gridX][gridY] && !towers[gridX][gridY].active) {
-                int cost = g_towerStats[g_selectedBuildType][0].cost;
-                if (playerMoney >= cost) {
-                    playerMoney -= cost;
-                    Tower *newTower = &towers[gridX][gridY];
-                    newTower->active = true;
-                    newTower->pos = (Vector2){(float)gridX, (float)gridY};
-                    newTower->type = g_selectedBuildType;
-                    newTower->level = 0;
-                    newTower->fireCooldown = 0.0f;
-                    newTower->targetIndex = -1;
-                    newTower->rotation = 0.0f;
-                    newTower->muzzleFlashTimer = 0.0f;
-                    g_selectedBuildType = -1; // Deselect after building
-                    PlaySound(sndPlace);
-                } else {
-                    PlaySound(sndError);
-                }
+            if (IssueCommand((GameCommand){CMD_BUILD_TOWER, gridX, gridY, g_selectedBuildType})) {
+                g_selectedBuildType = -1; // Deselect after building
+                PlaySound(sndPlace);
             } else {
                 PlaySound(sndError);
             }
@@ -554,76 +2110,2235 @@ void HandleInput() {
     }
 }
 
-void UpdateGame(float dt) {
-    UpdateMusicStream(music);
-    HandleInput(); // Handle input regardless of pause state to allow unpausing
+// --- Compact Encoding ---
+// LEB128 varints and zigzag mapping, shared by replays and telemetry
+
+static size_t PutVarint(uint8_t *out, uint32_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+static bool GetVarint(const uint8_t *data, size_t end, size_t *offset, uint32_t *value) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35 && *offset < end; shift += 7) {
+        uint8_t byte = data[(*offset)++];
+        result |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t ZigZagEncode(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+static int32_t ZigZagDecode(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+// --- Replay System ---
+// File layout (host byte order):
+//   ReplayHeader
+//   Records, in tick order. Each is a kind byte, a varint tick delta from the previous record,
+//   then either the command fields as varints or a varint size plus a GameSnapshot taken at the
+//   start of its tick (raw, or DEFLATE-compressed when recording with --compress).
+//   Padding to 8 bytes, then a ReplayIndexEntry per keyframe (tick -> byte offset of its record)
+//   ReplayFooter
+// The viewer maps the file and seeks by restoring the nearest keyframe at or before the
+// target tick, then simulating the few ticks in between. Records are encoded, compressed
+// and written on a background thread so the frame loop never waits on disk.
+
+static void WriteReplayJob(const ReplayWriteJob *job) {
+    uint8_t head[1 + 5 * 6];
+    size_t headSize = 0;
+    uint64_t recordOffset = replayRecorder.bytesWritten;
+    const uint8_t *body = NULL;
+    uint8_t *compressed = NULL;
+    int bodySize = 0;
+
+    uint8_t kind = job->kind;
+    if (kind == REPLAY_RECORD_KEYFRAME_RAW) {
+        body = (const uint8_t *)job->snapshot;
+        bodySize = sizeof(GameSnapshot);
+        if (replayRecorder.compressKeyframes) {
+            int compressedSize = 0;
+            compressed = CompressData(body, bodySize, &compressedSize);
+            if (compressed && compressedSize < bodySize) {
+                kind = REPLAY_RECORD_KEYFRAME_DEFLATE;
+                body = compressed;
+                bodySize = compressedSize;
+            }
+        }
+    }
+
+    head[headSize++] = kind;
+    headSize += PutVarint(head + headSize, job->tick - replayRecorder.lastWrittenTick);
+    if (kind == REPLAY_RECORD_COMMAND) {
+        headSize += PutVarint(head + headSize, job->command.type);
+        headSize += PutVarint(head + headSize, job->command.x);
+        headSize += PutVarint(head + headSize, job->command.y);
+        headSize += PutVarint(head + headSize, job->command.towerType);
+    } else {
+        headSize += PutVarint(head + headSize, (uint32_t)bodySize);
+    }
+    fwrite(head, 1, headSize, replayRecorder.file);
+    if (bodySize > 0) fwrite(body, 1, bodySize, replayRecorder.file);
+    replayRecorder.bytesWritten += headSize + bodySize;
+    replayRecorder.lastWrittenTick = job->tick;
+
+    if (job->kind == REPLAY_RECORD_KEYFRAME_RAW) {
+        if (replayRecorder.keyframeCount == replayRecorder.indexCapacity) {
+            int capacity = replayRecorder.indexCapacity ? replayRecorder.indexCapacity * 2 : 64;
+            ReplayIndexEntry *grown = realloc(replayRecorder.index, capacity * sizeof(ReplayIndexEntry));
+            if (grown) {
+                replayRecorder.index = grown;
+                replayRecorder.indexCapacity = capacity;
+            }
+        }
+        if (replayRecorder.keyframeCount < replayRecorder.indexCapacity) {
+            replayRecorder.index[replayRecorder.keyframeCount++] = (ReplayIndexEntry){job->tick, 0, recordOffset};
+        }
+    }
+    if (compressed) MemFree(compressed);
+    free(job->snapshot);
+}
+
+static void *ReplayWriterThread(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&replayRecorder.lock);
+        while (replayRecorder.queueCount == 0 && !replayRecorder.closing) {
+            pthread_cond_wait(&replayRecorder.notEmpty, &replayRecorder.lock);
+        }
+        if (replayRecorder.queueCount == 0) { // Closing and drained
+            pthread_mutex_unlock(&replayRecorder.lock);
+            return NULL;
+        }
+        ReplayWriteJob job = replayRecorder.queue[replayRecorder.queueHead];
+        replayRecorder.queueHead = (replayRecorder.queueHead + 1) % REPLAY_QUEUE_CAPACITY;
+        replayRecorder.queueCount--;
+        pthread_cond_signal(&replayRecorder.notFull);
+        pthread_mutex_unlock(&replayRecorder.lock);
+
+        WriteReplayJob(&job);
+    }
+}
+
+static void QueueReplayJob(ReplayWriteJob job) {
+    pthread_mutex_lock(&replayRecorder.lock);
+    while (replayRecorder.queueCount == REPLAY_QUEUE_CAPACITY) {
+        pthread_cond_wait(&replayRecorder.notFull, &replayRecorder.lock);
+    }
+    replayRecorder.queue[(replayRecorder.queueHead + replayRecorder.queueCount) % REPLAY_QUEUE_CAPACITY] = job;
+    replayRecorder.queueCount++;
+    pthread_cond_signal(&replayRecorder.notEmpty);
+    pthread_mutex_unlock(&replayRecorder.lock);
+}
+
+static void QueueReplayKeyframe() {
+    GameSnapshot *snapshot = malloc(sizeof(GameSnapshot));
+    if (!snapshot) return;
+    CaptureSnapshot(snapshot);
+    QueueReplayJob((ReplayWriteJob){REPLAY_RECORD_KEYFRAME_RAW, simTick, {0}, snapshot});
+    replayRecorder.lastKeyframeTick = simTick;
+}
+
+bool StartReplayRecording(const char *filename, Vector2 startPos, Vector2 endPos, bool compress) {
+    replayRecorder.file = fopen(filename, "wb");
+    if (!replayRecorder.file) {
+        printf("Failed to open replay file for writing: %s\n", filename);
+        return false;
+    }
+    ReplayHeader header = {0};
+    memcpy(header.magic, REPLAY_MAGIC, 4);
+    header.version = REPLAY_VERSION;
+    header.gridSize = GRID_SIZE;
+    header.keyframeInterval = REPLAY_KEYFRAME_INTERVAL;
+    for (int x = 0; x < GRID_SIZE; x++) {
+        for (int y = 0; y < GRID_SIZE; y++) header.walls[x][y] = walls[x][y];
+    }
+    header.startX = (int32_t)startPos.x; header.startY = (int32_t)startPos.y;
+    header.endX = (int32_t)endPos.x; header.endY = (int32_t)endPos.y;
+    fwrite(&header, sizeof(header), 1, replayRecorder.file);
+    replayRecorder.bytesWritten = sizeof(header);
+    replayRecorder.compressKeyframes = compress;
+    pthread_mutex_init(&replayRecorder.lock, NULL);
+    pthread_cond_init(&replayRecorder.notEmpty, NULL);
+    pthread_cond_init(&replayRecorder.notFull, NULL);
+    if (pthread_create(&replayRecorder.writer, NULL, ReplayWriterThread, NULL) != 0) {
+        fclose(replayRecorder.file);
+        replayRecorder.file = NULL;
+        return false;
+    }
+    QueueReplayKeyframe(); // Tick 0 is always seekable
+    return true;
+}
+
+void RecordReplayCommand(const GameCommand *cmd) {
+    if (!replayRecorder.file) return;
+    QueueReplayJob((ReplayWriteJob){REPLAY_RECORD_COMMAND, simTick, *cmd, NULL});
+}
+
+// Called after every sim tick
+void RecordReplayTick() {
+    if (!replayRecorder.file) return;
+    if (simTick % REPLAY_KEYFRAME_INTERVAL == 0) QueueReplayKeyframe();
+}
+
+void FinishReplayRecording() {
+    if (!replayRecorder.file) return;
+    if (replayRecorder.lastKeyframeTick != simTick) QueueReplayKeyframe(); // Marks the end tick
+
+    pthread_mutex_lock(&replayRecorder.lock);
+    replayRecorder.closing = true;
+    pthread_cond_signal(&replayRecorder.notEmpty);
+    pthread_mutex_unlock(&replayRecorder.lock);
+    pthread_join(replayRecorder.writer, NULL);
+
+    static const uint8_t padding[8] = {0};
+    size_t padBytes = (8 - replayRecorder.bytesWritten % 8) % 8; // Keeps the mapped index 8-byte aligned
+    fwrite(padding, 1, padBytes, replayRecorder.file);
+    replayRecorder.bytesWritten += padBytes;
+    ReplayFooter footer = {replayRecorder.bytesWritten, (uint32_t)replayRecorder.keyframeCount, REPLAY_INDEX_MAGIC};
+    fwrite(replayRecorder.index, sizeof(ReplayIndexEntry), replayRecorder.keyframeCount, replayRecorder.file);
+    fwrite(&footer, sizeof(footer), 1, replayRecorder.file);
+    fclose(replayRecorder.file);
+    free(replayRecorder.index);
+    pthread_mutex_destroy(&replayRecorder.lock);
+    pthread_cond_destroy(&replayRecorder.notEmpty);
+    pthread_cond_destroy(&replayRecorder.notFull);
+    memset(&replayRecorder, 0, sizeof(replayRecorder));
+}
+
+// Decodes the record at offset. prevTick is the tick of the record before it.
+static bool ReadReplayRecord(const ReplayViewer *viewer, size_t offset, uint32_t prevTick, ReplayRecord *record) {
+    if (offset >= viewer->recordsEnd) return false;
+    uint32_t tickDelta;
+    record->kind = viewer->data[offset++];
+    if (!GetVarint(viewer->data, viewer->recordsEnd, &offset, &tickDelta)) return false;
+    record->tick = prevTick + tickDelta;
+
+    if (record->kind == REPLAY_RECORD_COMMAND) {
+        uint32_t fields[4];
+        for (int i = 0; i < 4; i++) {
+            if (!GetVarint(viewer->data, viewer->recordsEnd, &offset, &fields[i])) return false;
+        }
+        record->command = (GameCommand){(uint8_t)fields[0], (uint8_t)fields[1], (uint8_t)fields[2], (uint8_t)fields[3]};
+        record->payload = NULL;
+        record->payloadSize = 0;
+    } else if (record->kind == REPLAY_RECORD_KEYFRAME_RAW || record->kind == REPLAY_RECORD_KEYFRAME_DEFLATE) {
+        if (!GetVarint(viewer->data, viewer->recordsEnd, &offset, &record->payloadSize)) return false;
+        if (record->payloadSize > viewer->recordsEnd - offset) return false; // Truncated tail
+        record->payload = viewer->data + offset;
+        offset += record->payloadSize;
+    } else {
+        return false;
+    }
+    record->next = offset;
+    return true;
+}
+
+static bool DecodeReplayKeyframe(const ReplayRecord *record, GameSnapshot *snapshot) {
+    if (record->kind == REPLAY_RECORD_KEYFRAME_RAW) {
+        if (record->payloadSize != sizeof(*snapshot)) return false;
+        memcpy(snapshot, record->payload, sizeof(*snapshot)); // Records are not aligned
+        return true;
+    }
+    int size = 0;
+    unsigned char *raw = DecompressData(record->payload, (int)record->payloadSize, &size);
+    bool ok = raw && size == (int)sizeof(*snapshot);
+    if (ok) memcpy(snapshot, raw, sizeof(*snapshot));
+    if (raw) MemFree(raw);
+    return ok;
+}
+
+// Rebuilds the keyframe index by walking the records, for files whose recording never finished
+static bool ScanReplayIndex(ReplayViewer *viewer) {
+    int capacity = 64, count = 0;
+    ReplayIndexEntry *index = malloc(capacity * sizeof(ReplayIndexEntry));
+    size_t offset = sizeof(ReplayHeader);
+    uint32_t tick = 0;
+    ReplayRecord record;
+    viewer->recordsEnd = viewer->size;
+    while (index && ReadReplayRecord(viewer, offset, tick, &record)) {
+        if (record.kind != REPLAY_RECORD_COMMAND) {
+            if (count == capacity) {
+                capacity *= 2;
+                ReplayIndexEntry *grown = realloc(index, capacity * sizeof(ReplayIndexEntry));
+                if (!grown) break;
+                index = grown;
+            }
+            index[count++] = (ReplayIndexEntry){record.tick, 0, offset};
+        }
+        tick = record.tick;
+        offset = record.next;
+    }
+    if (!index || count == 0) {
+        free(index);
+        return false;
+    }
+    viewer->ownedIndex = index;
+    viewer->index = index;
+    viewer->keyframeCount = count;
+    viewer->recordsEnd = offset;
+    return true;
+}
+
+bool OpenReplay(const char *filename, ReplayViewer *viewer) {
+    memset(viewer, 0, sizeof(*viewer));
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        printf("Failed to open replay file: %s\n", filename);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(ReplayHeader)) {
+        close(fd);
+        return false;
+    }
+    void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping stays valid
+    if (data == MAP_FAILED) return false;
+    viewer->data = data;
+    viewer->size = info.st_size;
+    viewer->header = (const ReplayHeader *)data;
+
+    if (memcmp(viewer->header->magic, REPLAY_MAGIC, 4) != 0 || viewer->header->version != REPLAY_VERSION ||
+        viewer->header->gridSize != GRID_SIZE) {
+        printf("Unsupported replay file: %s\n", filename);
+        CloseReplay(viewer);
+        return false;
+    }
+
+    // Prefer the trailing index; fall back to a scan if the footer is missing or damaged
+    const ReplayFooter *footer = (const ReplayFooter *)(viewer->data + viewer->size - sizeof(ReplayFooter));
+    bool haveFooter = viewer->size >= sizeof(ReplayHeader) + sizeof(ReplayFooter) && memcmp(footer->magic, REPLAY_INDEX_MAGIC, 4) == 0 &&
+                      footer->indexOffset + (uint64_t)footer->keyframeCount * sizeof(ReplayIndexEntry) + sizeof(ReplayFooter) == viewer->size;
+    if (haveFooter && footer->keyframeCount > 0) {
+        viewer->index = (const ReplayIndexEntry *)(viewer->data + footer->indexOffset);
+        viewer->keyframeCount = footer->keyframeCount;
+        viewer->recordsEnd = footer->indexOffset;
+    } else if (!ScanReplayIndex(viewer)) {
+        printf("Replay has no keyframes: %s\n", filename);
+        CloseReplay(viewer);
+        return false;
+    }
+    viewer->endTick = viewer->index[viewer->keyframeCount - 1].tick;
+    return true;
+}
+
+void CloseReplay(ReplayViewer *viewer) {
+    if (viewer->data) munmap((void *)viewer->data, viewer->size);
+    free(viewer->ownedIndex);
+    memset(viewer, 0, sizeof(*viewer));
+}
+
+// Loads the replay's map into walls/path
+bool LoadReplayMap(const ReplayViewer *viewer) {
+    for (int x = 0; x < GRID_SIZE; x++) {
+        for (int y = 0; y < GRID_SIZE; y++) walls[x][y] = viewer->header->walls[x][y];
+    }
+    Vector2 start = {(float)viewer->header->startX, (float)viewer->header->startY};
+    Vector2 end = {(float)viewer->header->endX, (float)viewer->header->endY};
+    return FindPathBFS(start, end);
+}
+
+// Applies the commands due at the current tick, then simulates it.
+// Returns false once the recording has no more ticks to play.
+bool StepReplay(ReplayViewer *viewer) {
+    if (simTick >= viewer->endTick) return false;
+    ReplayRecord record;
+    while (ReadReplayRecord(viewer, viewer->cursor, viewer->cursorTick, &record) && record.tick <= simTick) {
+        if (record.kind == REPLAY_RECORD_COMMAND && record.tick == simTick) ApplyCommand(&record.command);
+        viewer->cursor = record.next;
+        viewer->cursorTick = record.tick;
+    }
+    if (gameState != GAME_STATE_PLAYING) return false; // Nothing left that advances time
+    SimulateTick(SIM_TICK_DT);
+    return true;
+}
+
+void SeekReplay(ReplayViewer *viewer, uint32_t targetTick) {
+    if (targetTick > viewer->endTick) targetTick = viewer->endTick;
+
+    // Last keyframe at or before the target
+    int lo = 0, hi = viewer->keyframeCount - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (viewer->index[mid].tick <= targetTick) lo = mid; else hi = mid - 1;
+    }
+    ReplayRecord record;
+    GameSnapshot snapshot;
+    if (!ReadReplayRecord(viewer, viewer->index[lo].offset, 0, &record) || !DecodeReplayKeyframe(&record, &snapshot)) {
+        TraceLog(LOG_WARNING, "Replay keyframe at tick %u is damaged", viewer->index[lo].tick);
+        return;
+    }
+    RestoreSnapshot(&snapshot);
+    viewer->cursor = record.next;
+    viewer->cursorTick = viewer->index[lo].tick; // Keyframe ticks come from the index
+
+    bool wasMuted = g_muteSimSounds, wasHidden = g_hidePopups;
+    g_muteSimSounds = g_hidePopups = true;
+    while (simTick < targetTick && StepReplay(viewer)) {}
+    g_muteSimSounds = wasMuted;
+    g_hidePopups = wasHidden;
+}
+
+// --- Telemetry ---
+// Per-tick money, health and live enemy counts, appended to the file a block of
+// TELEMETRY_BLOCK_SIZE ticks at a time so a crash loses at most the block being filled. Each
+// block starts with varints for the run, the tick of its first row and its row count; then per
+// column a zigzag varint first value, a bit width, and the zigzag deltas bit-packed at that
+// width. Blocks are self-contained so decoding streams.
+
+// Worst case per block: three 5 byte varints up front, then per column a 5 byte varint, 1 byte
+// width and 32 bits per delta
+#define TELEMETRY_MAX_BLOCK_BYTES (15 + TELEMETRY_COLUMN_COUNT * (6 + TELEMETRY_BLOCK_SIZE * 4))
+
+static size_t EncodeTelemetryBlock(const int32_t *values, uint32_t count, uint8_t *out) {
+    size_t n = PutVarint(out, ZigZagEncode(values[0]));
+    uint32_t deltas[TELEMETRY_BLOCK_SIZE];
+    uint32_t all = 0;
+    for (uint32_t i = 1; i < count; i++) {
+        deltas[i] = ZigZagEncode(values[i] - values[i - 1]);
+        all |= deltas[i];
+    }
+    int width = 0;
+    while (width < 32 && (all >> width)) width++;
+    out[n++] = (uint8_t)width;
+
+    uint64_t bitBuffer = 0;
+    int bitCount = 0;
+    for (uint32_t i = 1; i < count; i++) {
+        bitBuffer |= (uint64_t)deltas[i] << bitCount;
+        bitCount += width;
+        while (bitCount >= 8) {
+            out[n++] = (uint8_t)bitBuffer;
+            bitBuffer >>= 8;
+            bitCount -= 8;
+        }
+    }
+    if (bitCount > 0) out[n++] = (uint8_t)bitBuffer;
+    return n;
+}
+
+static bool DecodeTelemetryBlock(const uint8_t *data, size_t end, size_t *offset, uint32_t count, int32_t *values) {
+    uint32_t first;
+    if (!GetVarint(data, end, offset, &first) || *offset >= end) return false;
+    int width = data[(*offset)++];
+    if (width > 32 || *offset + ((count - 1) * (size_t)width + 7) / 8 > end) return false;
+    values[0] = ZigZagDecode(first);
+
+    uint64_t bitBuffer = 0;
+    int bitCount = 0;
+    uint64_t mask = (width == 32) ? 0xFFFFFFFFull : ((1ull << width) - 1);
+    for (uint32_t i = 1; i < count; i++) {
+        while (bitCount < width) {
+            bitBuffer |= (uint64_t)data[(*offset)++] << bitCount;
+            bitCount += 8;
+        }
+        values[i] = values[i - 1] + ZigZagDecode((uint32_t)(bitBuffer & mask));
+        bitBuffer >>= width;
+        bitCount -= width;
+    }
+    return true;
+}
+
+// Appends the rows gathered so far as one block
+static void FlushTelemetryBlock() {
+    if (!telemetry.enabled || telemetry.count == 0) return;
+    if (!telemetry.file) {
+        telemetry.file = fopen(telemetry.filename, "wb");
+        if (!telemetry.file) {
+            printf("Failed to open telemetry file for writing: %s\n", telemetry.filename);
+            telemetry.enabled = false;
+            return;
+        }
+        TelemetryHeader header = {TELEMETRY_MAGIC, TELEMETRY_VERSION, TELEMETRY_COLUMN_COUNT, TELEMETRY_BLOCK_SIZE};
+        fwrite(&header, sizeof(header), 1, telemetry.file);
+    }
+    uint8_t block[TELEMETRY_MAX_BLOCK_BYTES];
+    size_t size = PutVarint(block, telemetry.run);
+    size += PutVarint(block + size, telemetry.firstTick);
+    size += PutVarint(block + size, telemetry.count);
+    for (int c = 0; c < TELEMETRY_COLUMN_COUNT; c++) size += EncodeTelemetryBlock(telemetry.columns[c], telemetry.count, block + size);
+    fwrite(block, 1, size, telemetry.file);
+    fflush(telemetry.file);
+    telemetry.count = 0;
+}
+
+// Only ticks played live are recorded; seeks, branches and other catch-up runs are muted
+void RecordTelemetryTick() {
+    if (!telemetry.enabled || g_muteSimSounds || simTick <= telemetry.lastTick) return;
+    if (telemetry.count > 0 && simTick != telemetry.lastTick + 1) FlushTelemetryBlock(); // Rows in a block are consecutive
+    if (telemetry.count == 0) telemetry.firstTick = simTick;
+    int liveEnemies = 0;
+    for (int i = 0; i < activeWave.enemiesSpawned; i++) liveEnemies += activeWave.enemies[i].active;
+    telemetry.columns[TELEMETRY_MONEY][telemetry.count] = playerMoney;
+    telemetry.columns[TELEMETRY_HEALTH][telemetry.count] = playerHealth;
+    telemetry.columns[TELEMETRY_LIVE_ENEMIES][telemetry.count] = liveEnemies;
+    telemetry.count++;
+    telemetry.lastTick = simTick;
+    if (telemetry.count == TELEMETRY_BLOCK_SIZE) FlushTelemetryBlock();
+}
+
+// A restart ends the current run; the next one counts its ticks from zero again
+void StartTelemetryRun() {
+    FlushTelemetryBlock();
+    if (telemetry.lastTick) telemetry.run++;
+    telemetry.lastTick = 0;
+}
+
+void FinishTelemetry() {
+    if (!telemetry.enabled) return;
+    FlushTelemetryBlock();
+    if (telemetry.file) fclose(telemetry.file);
+    memset(&telemetry, 0, sizeof(telemetry));
+}
+
+// Streams a telemetry file to stdout as CSV
+int DumpTelemetry(const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        printf("Failed to open telemetry file: %s\n", filename);
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *data = malloc(size > 0 ? size : 1);
+    bool ok = data && fread(data, 1, size, file) == (size_t)size;
+    fclose(file);
+    const TelemetryHeader *header = (const TelemetryHeader *)data;
+    if (!ok || size < (long)sizeof(*header) || memcmp(header->magic, TELEMETRY_MAGIC, 4) != 0 ||
+        header->version != TELEMETRY_VERSION || header->columnCount != TELEMETRY_COLUMN_COUNT || header->blockSize != TELEMETRY_BLOCK_SIZE) {
+        printf("Unsupported telemetry file: %s\n", filename);
+        free(data);
+        return 1;
+    }
+
+    double startTime = (double)clock() / CLOCKS_PER_SEC;
+    size_t offset = sizeof(*header);
+    int32_t values[TELEMETRY_COLUMN_COUNT][TELEMETRY_BLOCK_SIZE];
+    uint32_t rows = 0;
+    int result = 0;
+    printf("run,tick,money,health,live_enemies\n");
+    while (offset < (size_t)size) {
+        // A session that crashed mid-write can leave a partial block at the end
+        uint32_t run, firstTick, count;
+        bool valid = GetVarint(data, size, &offset, &run) && GetVarint(data, size, &offset, &firstTick) &&
+                     GetVarint(data, size, &offset, &count) && count > 0 && count <= TELEMETRY_BLOCK_SIZE;
+        for (int c = 0; valid && c < TELEMETRY_COLUMN_COUNT; c++) valid = DecodeTelemetryBlock(data, size, &offset, count, values[c]);
+        if (!valid) {
+            fprintf(stderr, "Telemetry truncated after %u ticks\n", rows);
+            result = 1;
+            break;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            printf("%u,%u,%d,%d,%d\n", run, firstTick + i, values[TELEMETRY_MONEY][i], values[TELEMETRY_HEALTH][i], values[TELEMETRY_LIVE_ENEMIES][i]);
+        }
+        rows += count;
+    }
+    double elapsed = (double)clock() / CLOCKS_PER_SEC - startTime;
+    fprintf(stderr, "Decoded %u ticks from %ld bytes in %.3fs (%.0fx real time)\n", rows, size, elapsed,
+            elapsed > 0 ? rows / (double)SIM_TICKS_PER_SECOND / elapsed : 0.0);
+    free(data);
+    return result;
+}
+
+// Caps the real time still owed to the sim after a frame ran its tick budget. Up to one more
+// frame's budget carries over; anything beyond is dropped, so on a machine that cannot keep up
+// game time runs slower than real time rather than falling ever further behind.
+static void ClampSimBacklog(int maxTicks) {
+    float maxBacklog = maxTicks * SIM_TICK_SECONDS;
+    if (simTimeAccumulator > maxBacklog) simTimeAccumulator = maxBacklog;
+}
+
+void UpdateReplayViewer(float dt) {
+    UpdateMusicStream(music);
+    if (IsKeyPressed(KEY_P) || IsKeyPressed(KEY_SPACE)) g_isPaused = !g_isPaused;
+    if (IsKeyPressed(KEY_F)) gameSpeed = (gameSpeed == 1.0f) ? 2.0f : (gameSpeed == 2.0f) ? 8.0f : 1.0f;
+
+    // Scrubbing: arrow keys jump, clicking or dragging on the timeline seeks
+    uint32_t jump = 5 * SIM_TICKS_PER_SECOND;
+    if (IsKeyPressed(KEY_RIGHT)) SeekReplay(&replayViewer, simTick + jump);
+    if (IsKeyPressed(KEY_LEFT)) SeekReplay(&replayViewer, simTick > jump ? simTick - jump : 0);
+    Rectangle bar = GetReplayTimelineRect();
+    Vector2 mousePos = GetMousePosition();
+    if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) && CheckCollisionPointRec(mousePos, bar)) {
+        float t = (mousePos.x - bar.x) / bar.width;
+        SeekReplay(&replayViewer, (uint32_t)(t * replayViewer.endTick));
+        simTimeAccumulator = 0.0f;
+    }
+
+    if (g_isPaused) return;
+    simTimeAccumulator += dt * gameSpeed;
+    for (int ticks = 0; ticks < MAX_SIM_TICKS_PER_FRAME * 4 && simTimeAccumulator >= SIM_TICK_SECONDS; ticks++) {
+        if (!StepReplay(&replayViewer)) {
+            simTimeAccumulator = 0.0f; // The replay has ended
+            break;
+        }
+        simTimeAccumulator -= SIM_TICK_SECONDS;
+    }
+    ClampSimBacklog(MAX_SIM_TICKS_PER_FRAME * 4);
+}
+
+Rectangle GetReplayTimelineRect() {
+    return (Rectangle){20, SCREEN_HEIGHT - 24, GAME_AREA_WIDTH - 40, 10};
+}
+
+void DrawReplayTimeline() {
+    Rectangle bar = GetReplayTimelineRect();
+    float t = replayViewer.endTick ? (float)simTick / replayViewer.endTick : 0.0f;
+    DrawRectangleRec(bar, Fade(BLACK, 0.7f));
+    DrawRectangleRec((Rectangle){bar.x, bar.y, bar.width * t, bar.height}, COLOR_UI_ACCENT);
+    for (int i = 0; i < replayViewer.keyframeCount; i++) {
+        float kx = bar.x + bar.width * replayViewer.index[i].tick / (float)(replayViewer.endTick ? replayViewer.endTick : 1);
+        DrawLine(kx, bar.y, kx, bar.y + bar.height, Fade(COLOR_NEON_WHITE, 0.3f));
+    }
+    DrawRectangleLinesEx(bar, 1, COLOR_NEON_CYAN);
+    int seconds = (int)(simTick * SIM_TICK_SECONDS), totalSeconds = (int)(replayViewer.endTick * SIM_TICK_SECONDS);
+    DrawText(TextFormat("REPLAY %d:%02d / %d:%02d  (%.0fx)", seconds / 60, seconds % 60, totalSeconds / 60, totalSeconds % 60, gameSpeed),
+             bar.x, bar.y - 18, 10, COLOR_NEON_WHITE);
+}
+
+void UpdateGame(float dt) {
+    UpdateMusicStream(music);
+    HandleInput(); // Handle input regardless of pause state to allow unpausing
+
+    if (g_isPaused) return; // Stop game logic updates if paused
+
+    switch (gameState) {
+        case GAME_STATE_PLAYING:
+            // Frame time only decides how many fixed ticks run; the sim itself always sees SIM_TICK_DT
+            simTimeAccumulator += dt * gameSpeed; // Apply game speed multiplier
+            for (int ticks = 0; ticks < MAX_SIM_TICKS_PER_FRAME && simTimeAccumulator >= SIM_TICK_SECONDS; ticks++) {
+                SimulateTick(SIM_TICK_DT);
+                simTimeAccumulator -= SIM_TICK_SECONDS;
+            }
+            ClampSimBacklog(MAX_SIM_TICKS_PER_FRAME);
+            break;
+        case GAME_STATE_WAVE_TRANSITION:
+            // Handled by UI button now
+            break;
+        case GAME_STATE_GAME_OVER:
+        case GAME_STATE_VICTORY:
+            if (IsKeyPressed(KEY_R)) {
+                FinishReplayRecording(); // A replay covers a single run
+                RestartGame();
+            }
+            break;
+    }
+}
+
+void SimulateTick(fixed_t dt) {
+    if (gameState != GAME_STATE_PLAYING) return;
+    UpdateEnemies(&activeWave, dt);
+    UpdateWave(&activeWave, dt);
+    InvalidateEnemyPositions(); // Positions and the neighbor grid rebuild on first use
+    AdvanceKineticSchedule(dt);
+    UpdateShots();
+    UpdateTowers(dt);
+    CheckWaveCompletion();
+    simTick++;
+    RecordReplayTick();
+    RecordTelemetryTick();
+}
+
+// --- Time Skipping ---
+// Much of a headless run is enemies walking stretches no tower covers while towers count down.
+// FindIdleTicks measures how long that lasts: until the next spawn, coverage entry (from the
+// kinetic schedule), slow pulse on a covered enemy, shot landing or leak, and only while no
+// two enemies come close enough for lane spreading to move them. SkipIdleTicks then applies
+// those ticks in closed form: enemies advance along the path, slows and cooldowns run down, and
+// the wave's spawn timer advances. The resulting state is the same as ticking one at a time.
+// A tower that has an enemy in range stays engaged until a coverage crossing comes due or an
+// enemy is killed (paying out) or leaks (costing health), so there is no point asking again
+// before one of those; most of a busy wave is spent in that state.
+
+static int64_t NextKineticTick() {
+    return g_kinetic.eventCount > 0 ? g_kinetic.heap[0].tick : INT64_MAX;
+}
+
+// Runs the sim to endTick or until the wave ends, skipping idle stretches when enabled
+void SimulateUntil(uint32_t endTick) {
+    bool engaged = false;
+    int64_t engagedUntil = 0;
+    int engagedMoney = 0, engagedHealth = 0;
+    while (gameState == GAME_STATE_PLAYING && simTick < endTick) {
+        int idle = 0;
+        if (g_skipIdleTicks) {
+            if (NextKineticTick() < engagedUntil) engagedUntil = NextKineticTick(); // A slow rescheduled someone
+            if (simTick > engagedUntil || playerMoney != engagedMoney || playerHealth != engagedHealth) engaged = false;
+            if (!engaged) {
+                idle = FindIdleTicks(endTick - simTick, SIM_TICK_DT, &engaged);
+                engagedUntil = NextKineticTick();
+                engagedMoney = playerMoney;
+                engagedHealth = playerHealth;
+            }
+        }
+        if (idle > 1) SkipIdleTicks(idle, SIM_TICK_DT);
+        else SimulateTick(SIM_TICK_DT);
+    }
+}
+
+// Whether no two close-laned enemies get within LANE_SPACING of each other over the next ticks.
+// Path distances are linear between slow expiries, so checking the ends and expiries is enough.
+static bool LanesStaySettled(int ticks, fixed_t dt) {
+    for (int a = 0; a < activeWave.enemiesSpawned; a++) {
+        const Enemy *ea = &activeWave.enemies[a];
+        if (!ea->active) continue;
+        for (int b = a + 1; b < activeWave.enemiesSpawned; b++) {
+            const Enemy *eb = &activeWave.enemies[b];
+            if (!eb->active || llabs((int64_t)ea->laneOffset - eb->laneOffset) >= LANE_MIN_GAP) continue;
+            int samples[4] = {1, ticks, GetSlowTicks(ea, dt), GetSlowTicks(eb, dt)};
+            int sign = 0;
+            for (int i = 0; i < 4; i++) {
+                if (samples[i] < 1 || samples[i] > ticks) continue;
+                int64_t apart = PredictRawDistance(eb, samples[i], dt) - PredictRawDistance(ea, samples[i], dt);
+                int side = apart < 0 ? -1 : 1;
+                if (llabs(apart) < LANE_SPACING || (sign != 0 && side != sign)) return false;
+                sign = side;
+            }
+        }
+    }
+    return true;
+}
+
+// How many of the next maxTicks ticks can be skipped, 0 if the next one has to be simulated.
+// engaged is set when that is because a tower other than a slow one has an enemy in range.
+int FindIdleTicks(int maxTicks, fixed_t dt, bool *engaged) {
+    *engaged = false;
+    if (gameState != GAME_STATE_PLAYING || replayRecorder.file || telemetry.enabled) return 0; // Those record every tick
+    int limit = maxTicks;
+
+    // Wave: the next spawn, or the completion check once everything has spawned and died
+    bool anyActive = false;
+    for (int i = 0; i < activeWave.enemiesSpawned && !anyActive; i++) anyActive = activeWave.enemies[i].active;
+    if (activeWave.enemiesSpawned < activeWave.enemyCount) {
+        int untilSpawn = (int)((SPAWN_INTERVAL - activeWave.spawnTimer + dt - 1) / dt);
+        if (untilSpawn - 1 < limit) limit = untilSpawn - 1;
+    } else if (!anyActive) {
+        return 0;
+    }
+
+    // Towers: nothing may be covered, except by a slow tower whose next pulse is outside the window
+    for (int x = 0; x < GRID_SIZE; x++) {
+        for (int y = 0; y < GRID_SIZE; y++) {
+            const Tower *tower = &towers[x][y];
+            if (!tower->active) continue;
+            if (g_kinetic.armedVersion[x][y] != GetTowerCoverage(x, y)->version) return 0;
+            bool covered = false;
+            for (int w = 0; w < ENEMY_BITSET_WORDS && !covered; w++) {
+                uint64_t bits = g_kinetic.inside[x][y][w];
+                for (; bits && !covered; bits &= bits - 1) covered = activeWave.enemies[w * 64 + __builtin_ctzll(bits)].active;
+            }
+            if (tower->type != TOWER_SLOW) {
+                if (covered || tower->targetIndex != -1) {
+                    *engaged = true;
+                    return 0;
+                }
+            } else if (covered) {
+                int untilPulse = tower->fireCooldown > 0 ? (tower->fireCooldown + dt - 1) / dt : 1;
+                if (untilPulse - 1 < limit) limit = untilPulse - 1;
+            }
+        }
+    }
+
+    // Enemies: the next coverage crossing and the first leak
+    while (g_kinetic.eventCount > 0) {
+        const KineticEvent *next = &g_kinetic.heap[0];
+        if (next->version == g_kinetic.enemyVersion[next->enemyIndex] && activeWave.enemies[next->enemyIndex].active) break;
+        PopKineticEvent(); // Superseded, and would be dropped on the next tick anyway
+    }
+    if (g_kinetic.eventCount > 0 && g_kinetic.heap[0].tick - simTick < limit) limit = (int)(g_kinetic.heap[0].tick - simTick);
+    for (int i = 0; i < activeWave.enemiesSpawned && limit > 0; i++) {
+        const Enemy *enemy = &activeWave.enemies[i];
+        if (!enemy->active) continue;
+        int64_t untilEnd = TicksToReachDistance(enemy, FX_INT(pathLength - 1), dt); // It leaks the tick after
+        if (untilEnd >= 0 && untilEnd < limit) limit = (int)untilEnd;
+    }
+
+    // Shots in flight land on their own tick
+    for (int i = 0; i < activeWave.shotCount; i++) {
+        if (activeWave.shots[i].ticksLeft - 1 < limit) limit = activeWave.shots[i].ticksLeft - 1;
+    }
+
+    while (limit > 1 && !LanesStaySettled(limit, dt)) limit /= 2;
+    return limit > 0 ? limit : 0;
+}
+
+// Cooldown-style timer after `ticks` ticks of "if positive, subtract dt"
+static fixed_t RunDownTimer(fixed_t timer, int ticks, fixed_t dt) {
+    if (timer <= 0) return timer;
+    int64_t running = (timer + dt - 1) / dt;
+    return timer - (fixed_t)((ticks < running ? ticks : running) * dt);
+}
+
+// Applies ticks that FindIdleTicks reported as idle
+void SkipIdleTicks(int ticks, fixed_t dt) {
+    for (int i = 0; i < activeWave.enemiesSpawned; i++) {
+        Enemy *enemy = &activeWave.enemies[i];
+        int slowTicks = GetSlowTicks(enemy, dt);
+        if (enemy->active) {
+            int64_t distance = PredictRawDistance(enemy, ticks, dt);
+            enemy->pathIndex = (int)(distance >> FX_SHIFT) < pathLength - 1 ? (int)(distance >> FX_SHIFT) : pathLength - 1;
+            enemy->segmentProgress = (fixed_t)(distance - FX_INT(enemy->pathIndex));
+            UpdateEnemyProgress(enemy);
+        }
+        // Dead enemies' slows run down too, as in AdvanceEnemyRun
+        enemy->slowTimer -= (fixed_t)((ticks < slowTicks ? ticks : slowTicks) * dt);
+        if (ticks > slowTicks) enemy->speedMultiplier = FX_ONE;
+    }
+    if (activeWave.enemiesSpawned < activeWave.enemyCount) activeWave.spawnTimer += ticks * dt;
+    else activeWave.isFinished = true;
+    for (int i = 0; i < activeWave.shotCount; i++) activeWave.shots[i].ticksLeft -= ticks;
+
+    for (int x = 0; x < GRID_SIZE; x++) {
+        for (int y = 0; y < GRID_SIZE; y++) {
+            Tower *tower = &towers[x][y];
+            if (!tower->active) continue;
+            tower->muzzleFlashTimer = RunDownTimer(tower->muzzleFlashTimer, ticks, dt);
+            int untilPulse = tower->fireCooldown > 0 ? (tower->fireCooldown + dt - 1) / dt : 1;
+            if (tower->type != TOWER_SLOW || ticks < untilPulse) {
+                tower->fireCooldown = RunDownTimer(tower->fireCooldown, ticks, dt);
+            } else { // Pulses over nobody: back to the full interval each time
+                fixed_t pulseInterval = FxDiv(FX_ONE, g_towerStats[tower->type][tower->level].fireRate);
+                int period = (pulseInterval + dt - 1) / dt;
+                tower->fireCooldown = pulseInterval - ((ticks - untilPulse) % period) * dt;
+            }
+        }
+    }
+    simTick += ticks;
+    InvalidateEnemyPositions();
+}
+
+// --- Branch Evaluation ---
+// Explores alternative next moves from the current world. A fixed pool of worker processes is
+// forked once from the branch point, so every worker starts with the parent's world shared
+// copy-on-write; only pages a worker actually writes get duplicated. Each worker keeps claiming
+// candidates from a shared counter, rewinding to its private copy of the branch point between
+// them, and writes its results into a table mapped shared with the parent.
+
+static double GetWallSeconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Gathers every affordable build, upgrade and sell from the current world.
+// CMD_START_WAVE stands for leaving the board unchanged.
+int GenerateBranchCandidates(GameCommand *out, int maxCount) {
+    int count = 0;
+    out[count++] = (GameCommand){CMD_START_WAVE, 0, 0, 0};
+    for (int x = 0; x < GRID_SIZE; x++) {
+        for (int y = 0; y < GRID_SIZE; y++) {
+            Tower *tower = &towers[x][y];
+            if (tower->active) {
+                if (tower->level < MAX_TOWER_LEVEL - 1 && playerMoney >= g_towerStats[tower->type][tower->level + 1].cost && count < maxCount) {
+                    out[count++] = (GameCommand){CMD_UPGRADE_TOWER, x, y, 0};
+                }
+                if (count < maxCount) out[count++] = (GameCommand){CMD_SELL_TOWER, x, y, 0};
+            } else if (walls[x][y]) {
+                for (int type = 0; type < TOWER_TYPE_COUNT && count < maxCount; type++) {
+                    if (playerMoney >= g_towerStats[type][0].cost) out[count++] = (GameCommand){CMD_BUILD_TOWER, x, y, type};
+                }
+            }
+        }
+    }
+    return count;
+}
+
+// Applies the candidate, starts the next wave if none is running, and simulates until the
+// wave is over or horizonTicks have passed.
+static void RunBranch(const GameCommand *candidate, uint32_t horizonTicks, BranchResult *result) {
+    result->applied = ApplyCommand(candidate);
+    ApplyCommand(&(GameCommand){CMD_START_WAVE, 0, 0, 0});
+    uint32_t endTick = simTick + horizonTicks;
+    SimulateUntil(endTick);
+    result->playerHealth = playerHealth;
+    result->playerMoney = playerMoney;
+    result->waveNumber = currentWaveNumber;
+    result->gameState = gameState;
+    result->endTick = simTick;
+}
+
+static void RunBranchWorker(BranchTable *table, uint32_t horizonTicks) {
+    GameSnapshot branchPoint; // The only copy a worker makes; everything else is shared until written
+    CaptureSnapshot(&branchPoint);
+    bool dirty = false;
+    for (;;) {
+        int index = __atomic_fetch_add(&table->nextCandidate, 1, __ATOMIC_RELAXED);
+        if (index >= table->count) break;
+        if (dirty) RestoreSnapshot(&branchPoint);
+        RunBranch(&table->results[index].command, horizonTicks, &table->results[index]);
+        __atomic_store_n(&table->results[index].done, 1, __ATOMIC_RELEASE);
+        dirty = true;
+    }
+}
+
+// Evaluates every candidate against the current world using workerCount processes.
+// Returns a table the caller releases with FreeBranchTable, or NULL on failure.
+BranchTable *EvaluateBranches(const GameCommand *candidates, int count, uint32_t horizonTicks, int workerCount) {
+    size_t tableSize = sizeof(BranchTable) + count * sizeof(BranchResult);
+    BranchTable *table = mmap(NULL, tableSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (table == MAP_FAILED) return NULL;
+    table->count = count;
+    table->mappedSize = tableSize;
+    for (int i = 0; i < count; i++) table->results[i].command = candidates[i];
+    if (workerCount > count) workerCount = count;
+    if (workerCount > MAX_BRANCH_WORKERS) workerCount = MAX_BRANCH_WORKERS;
+
+    bool wasMuted = g_muteSimSounds, wasHidden = g_hidePopups;
+    g_muteSimSounds = g_hidePopups = true; // Children inherit these
+    fflush(stdout);         // Or the children would flush the parent's buffered output again
+    pid_t workers[MAX_BRANCH_WORKERS];
+    int started = 0;
+    for (; started < workerCount; started++) {
+        pid_t pid = fork();
+        if (pid < 0) break;
+        if (pid == 0) {
+            RunBranchWorker(table, horizonTicks);
+            _exit(0);
+        }
+        workers[started] = pid;
+    }
+    if (started == 0) RunBranchWorker(table, horizonTicks); // No fork available, evaluate in place
+    for (int i = 0; i < started; i++) waitpid(workers[i], NULL, 0);
+    g_muteSimSounds = wasMuted;
+    g_hidePopups = wasHidden;
+    return table;
+}
+
+void FreeBranchTable(BranchTable *table) {
+    if (table) munmap(table, table->mappedSize);
+}
+
+static int CompareBranchResults(const void *a, const void *b) {
+    const BranchResult *ra = a, *rb = b;
+    if (ra->done != rb->done) return rb->done - ra->done;
+    if (ra->playerHealth != rb->playerHealth) return rb->playerHealth - ra->playerHealth;
+    if (ra->playerMoney != rb->playerMoney) return rb->playerMoney - ra->playerMoney;
+    return memcmp(&ra->command, &rb->command, sizeof(GameCommand)); // Keeps ties in a stable order
+}
+
+static const char *DescribeCommand(const GameCommand *cmd) {
+    switch (cmd->type) {
+        case CMD_BUILD_TOWER: return TextFormat("build %s at %d,%d", g_towerNames[cmd->towerType], cmd->x, cmd->y);
+        case CMD_UPGRADE_TOWER: return TextFormat("upgrade %d,%d", cmd->x, cmd->y);
+        case CMD_SELL_TOWER: return TextFormat("sell %d,%d", cmd->x, cmd->y);
+        case CMD_START_WAVE: return "no change";
+    }
+    return "?";
+}
+
+// Headless tool: replays a recording up to atSeconds, then ranks every possible next move
+int RunBranchTool(const char *replayPath, float atSeconds, float horizonSeconds, int workerCount) {
+    if (!OpenReplay(replayPath, &replayViewer) || !LoadReplayMap(&replayViewer)) return 1;
+    InitializeGame();
+    g_muteSimSounds = g_hidePopups = true;
+    SeekReplay(&replayViewer, (uint32_t)(atSeconds * SIM_TICKS_PER_SECOND));
+    printf("Branch point: tick %u, wave %d, health %d, money %d\n", simTick, currentWaveNumber, playerHealth, playerMoney);
+
+    static GameCommand candidates[MAX_BRANCH_CANDIDATES];
+    int count = GenerateBranchCandidates(candidates, MAX_BRANCH_CANDIDATES);
+    if (workerCount <= 0) workerCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    double startTime = GetWallSeconds();
+    BranchTable *table = EvaluateBranches(candidates, count, (uint32_t)(horizonSeconds * SIM_TICKS_PER_SECOND), workerCount);
+    double elapsed = GetWallSeconds() - startTime;
+    if (!table) {
+        printf("Failed to map the branch result table\n");
+        CloseReplay(&replayViewer);
+        return 1;
+    }
+
+    qsort(table->results, table->count, sizeof(BranchResult), CompareBranchResults);
+    printf("rank,command,applied,health,money,wave,end_tick\n");
+    for (int i = 0; i < table->count; i++) {
+        const BranchResult *r = &table->results[i];
+        if (!r->done) {
+            printf("%d,%s,failed\n", i + 1, DescribeCommand(&r->command));
+            continue;
+        }
+        printf("%d,%s,%d,%d,%d,%d,%u\n", i + 1, DescribeCommand(&r->command), r->applied, r->playerHealth, r->playerMoney, r->waveNumber, r->endTick);
+    }
+    fprintf(stderr, "Evaluated %d branches with %d workers in %.3fs\n", count, workerCount < count ? workerCount : count, elapsed);
+    FreeBranchTable(table);
+    CloseReplay(&replayViewer);
+    return 0;
+}
+
+// --- Batch Simulation ---
+// Plays many complete games headlessly with simple strategy bots. Each worker is a forked
+// process pinned to one CPU. Everything a worker writes is first touched after pinning, so
+// under the kernel's first-touch policy its pages land on that CPU's NUMA node: the copy-on-write
+// copies of the world globals, and a private arena holding its slice of the scenarios and its
+// results. Workers publish their results and stats to a shared table when done, and the parent
+// merges them in scenario order.
+
+const char *g_strategyNames[STRATEGY_COUNT] = {"random", "upgrade"};
+
+static uint32_t NextRandom(uint32_t *state) {
+    uint32_t x = *state; // xorshift32
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+int FindStrategy(const char *name) {
+    for (int i = 0; i < STRATEGY_COUNT; i++) {
+        if (strcmp(name, g_strategyNames[i]) == 0) return i;
+    }
+    return -1;
+}
+
+// Path nodes a new tower of this type at (x, y) could reach
+static int CountCoveredPathNodes(int x, int y, int type) {
+    FxVec2 center = {FX_INT(x * cellWidth + cellWidth / 2), FX_INT(y * cellHeight + cellHeight / 2)};
+    int64_t rangeSqr = FxSquare(g_towerStats[type][0].range);
+    int covered = 0;
+    for (int i = 0; i < pathLength; i++) covered += FxDistanceSqr(center, pathPoints[i]) <= rangeSqr;
+    return covered;
+}
+
+// Spends money between waves the way the strategy prefers. Bots never build out of reach of the path.
+static void RunStrategyTurn(int strategy, uint32_t *rng) {
+    static GameCommand candidates[MAX_BRANCH_CANDIDATES];
+    static int builds[MAX_BRANCH_CANDIDATES], upgrades[MAX_BRANCH_CANDIDATES];
+    for (int spent = 0; spent < GRID_SIZE * GRID_SIZE; spent++) {
+        int count = GenerateBranchCandidates(candidates, MAX_BRANCH_CANDIDATES);
+        int buildCount = 0, upgradeCount = 0; // Sells and the no-op are never picked
+        for (int i = 0; i < count; i++) {
+            const GameCommand *cmd = &candidates[i];
+            if (cmd->type == CMD_BUILD_TOWER && CountCoveredPathNodes(cmd->x, cmd->y, cmd->towerType) > 0) builds[buildCount++] = i;
+            else if (cmd->type == CMD_UPGRADE_TOWER) upgrades[upgradeCount++] = i;
+        }
+        if (buildCount + upgradeCount == 0) break;
+
+        int pick;
+        if (strategy == STRATEGY_UPGRADE_FIRST && upgradeCount > 0) pick = upgrades[NextRandom(rng) % upgradeCount];
+        else {
+            int choice = NextRandom(rng) % (buildCount + upgradeCount);
+            pick = choice < buildCount ? builds[choice] : upgrades[choice - buildCount];
+        }
+        if (!ApplyCommand(&candidates[pick])) break;
+    }
+}
+
+// Loads the scenario's map and balance into a fresh world
+static void PrepareBatchGame(const BatchScenario *scenario) {
+    static int loadedMap = -1;
+    if (g_batchMaps && scenario->mapIndex != loadedMap) {
+        const MapData *map = &g_batchMaps[scenario->mapIndex];
+        for (int x = 0; x < GRID_SIZE; x++) {
+            for (int y = 0; y < GRID_SIZE; y++) walls[x][y] = map->walls[x][y];
+        }
+        FindPathBFS(map->start, map->end);
+        loadedMap = scenario->mapIndex;
+    }
+    g_balance = scenario->balance;
+    InitializeGame();
+}
+
+static void RecordBatchResult(const BatchScenario *scenario, BatchResult *result) {
+    result->seed = scenario->seed;
+    result->strategy = scenario->strategy;
+    result->victory = gameState == GAME_STATE_VICTORY;
+    result->estimated = 0;
+    result->waveReached = currentWaveNumber;
+    result->playerHealth = playerHealth;
+    result->playerMoney = playerMoney;
+    result->ticks = simTick;
+}
+
+// Plays one full game from a fresh world
+static void RunBatchGame(const BatchScenario *scenario, BatchResult *result) {
+    PrepareBatchGame(scenario);
+    uint32_t rng = scenario->seed ? scenario->seed : 1;
+    while (simTick < BATCH_MAX_TICKS && (gameState == GAME_STATE_PLAYING || gameState == GAME_STATE_WAVE_TRANSITION)) {
+        if (gameState == GAME_STATE_WAVE_TRANSITION) {
+            RunStrategyTurn(scenario->strategy, &rng);
+            ApplyCommand(&(GameCommand){CMD_START_WAVE, 0, 0, 0});
+        }
+        SimulateUntil(BATCH_MAX_TICKS);
+    }
+    RecordBatchResult(scenario, result);
+}
+
+// Reads /sys to find the NUMA node of each CPU; CPUs on machines without NUMA all report node 0
+static void ReadCpuNodes(int *cpuNode, int cpuCount) {
+    for (int cpu = 0; cpu < cpuCount; cpu++) cpuNode[cpu] = 0;
+    for (int node = 0; node < 64; node++) {
+        FILE *file = fopen(TextFormat("/sys/devices/system/node/node%d/cpulist", node), "r");
+        if (!file) continue;
+        int first, last;
+        while (fscanf(file, "%d", &first) == 1) { // Format: "0-15,32-47"
+            last = first;
+            if (fscanf(file, "-%d", &last) != 1) last = first;
+            for (int cpu = first; cpu <= last && cpu < cpuCount; cpu++) cpuNode[cpu] = node;
+            if (fgetc(file) != ',') break;
+        }
+        fclose(file);
+    }
+}
+
+static bool CreateArena(Arena *arena, size_t size) {
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return false;
+    memset(base, 0, size); // Fault every page in now, from the pinned CPU
+    arena->base = base;
+    arena->size = size;
+    arena->used = 0;
+    return true;
+}
+
+static void *ArenaAlloc(Arena *arena, size_t size) {
+    size_t start = (arena->used + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+    if (start + size > arena->size) return NULL;
+    arena->used = start + size;
+    return arena->base + start;
+}
+
+static void RunBatchWorker(BatchRun *run, int worker, const BatchScenario *scenarios, int first, int count, int cpu) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    sched_setaffinity(0, sizeof(cpus), &cpus); // Before anything below touches memory
+
+    Arena arena;
+    if (!CreateArena(&arena, count * (sizeof(BatchScenario) + sizeof(BatchResult)) + 2 * CACHE_LINE_SIZE)) return;
+    BatchScenario *localScenarios = ArenaAlloc(&arena, count * sizeof(BatchScenario));
+    BatchResult *localResults = ArenaAlloc(&arena, count * sizeof(BatchResult));
+    memcpy(localScenarios, scenarios + first, count * sizeof(BatchScenario));
+
+    double startTime = GetWallSeconds();
+    BatchWorkerStats local = {0};
+    for (int i = 0; i < count; i++) {
+        PlayBatchScenario(&localScenarios[i], &localResults[i], &local);
+        localResults[i].done = 1;
+        if (!localResults[i].estimated) local.ticks += localResults[i].ticks;
+    }
+    memcpy(run->results + first, localResults, count * sizeof(BatchResult));
+
+    BatchWorkerStats *stats = &run->stats[worker]; // Own cache line, so no false sharing between workers
+    stats->games = count;
+    stats->estimatedGames = local.estimatedGames;
+    stats->ticks = local.ticks;
+    stats->closeScore = local.closeScore;
+    stats->auditScore = local.auditScore;
+    stats->estimateSeconds = local.estimateSeconds;
+    stats->seconds = GetWallSeconds() - startTime - local.estimateSeconds; // Keeps ticks/s comparable with unscreened runs
+}
+
+// Runs every scenario across workerCount pinned processes. The returned run is released with FreeBatchRun.
+BatchRun *RunBatch(const BatchScenario *scenarios, int count, int workerCount) {
+    int cpuCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpuCount < 1) cpuCount = 1;
+    if (cpuCount > MAX_BATCH_WORKERS) cpuCount = MAX_BATCH_WORKERS;
+    if (workerCount <= 0) workerCount = cpuCount;
+    if (workerCount > count) workerCount = count;
+    if (workerCount > MAX_BATCH_WORKERS) workerCount = MAX_BATCH_WORKERS;
+    if (workerCount < 1) workerCount = 1;
+
+    size_t statsSize = MAX_BATCH_WORKERS * sizeof(BatchWorkerStats);
+    size_t mappedSize = sizeof(BatchRun) + statsSize + count * sizeof(BatchResult);
+    BatchRun *run = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (run == MAP_FAILED) return NULL;
+    run->mappedSize = mappedSize;
+    run->count = count;
+    run->workerCount = workerCount;
+    run->stats = (BatchWorkerStats *)((uint8_t *)run + ((sizeof(BatchRun) + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1)));
+    run->results = (BatchResult *)(run->stats + MAX_BATCH_WORKERS);
+
+    // Spread workers so each node gets a share before any node gets a second CPU busy
+    int cpuNode[MAX_BATCH_WORKERS];
+    ReadCpuNodes(cpuNode, cpuCount);
+    int order[MAX_BATCH_WORKERS], ordered = 0;
+    for (int round = 0; ordered < cpuCount; round++) {
+        for (int node = 0; node < 64 && ordered < cpuCount; node++) {
+            int seen = 0;
+            for (int cpu = 0; cpu < cpuCount; cpu++) {
+                if (cpuNode[cpu] == node && seen++ == round) order[ordered++] = cpu;
+            }
+        }
+    }
+
+    bool wasMuted = g_muteSimSounds, wasHidden = g_hidePopups;
+    g_muteSimSounds = g_hidePopups = true;
+    fflush(stdout);
+    pid_t workers[MAX_BATCH_WORKERS];
+    int started = 0;
+    for (int w = 0; w < workerCount; w++) {
+        int first = (int)((int64_t)count * w / workerCount);
+        int last = (int)((int64_t)count * (w + 1) / workerCount);
+        int cpu = order[w % cpuCount];
+        run->stats[w].cpu = cpu;
+        run->stats[w].node = cpuNode[cpu];
+        pid_t pid = fork();
+        if (pid == 0) {
+            RunBatchWorker(run, w, scenarios, first, last - first, cpu);
+            _exit(0);
+        }
+        if (pid > 0) workers[started++] = pid;
+        else RunBatchWorker(run, w, scenarios, first, last - first, cpu); // No fork available, run in place
+    }
+    for (int i = 0; i < started; i++) waitpid(workers[i], NULL, 0);
+    g_muteSimSounds = wasMuted;
+    g_hidePopups = wasHidden;
+    return run;
+}
+
+void FreeBatchRun(BatchRun *run) {
+    if (run) munmap(run, run->mappedSize);
+}
+
+// Per-worker and per-node throughput, with scaling relative to one average worker
+void PrintBatchReport(const BatchRun *run, FILE *out) {
+    PrintEstimateReport(run, out);
+    double perWorker = 0.0;
+    int measured = 0;
+    for (int w = 0; w < run->workerCount; w++) {
+        const BatchWorkerStats *stats = &run->stats[w];
+        if (stats->seconds <= 0.0) continue;
+        perWorker += stats->ticks / stats->seconds;
+        measured++;
+        fprintf(out, "worker %2d cpu %3d node %d: %d games, %.0f ticks/s\n", w, stats->cpu, stats->node, stats->games, stats->ticks / stats->seconds);
+    }
+    if (measured == 0 || perWorker <= 0.0) return; // Every game was estimated
+    perWorker /= measured;
+    double total = 0.0;
+    for (int node = 0; node < 64; node++) {
+        double nodeRate = 0.0;
+        int nodeWorkers = 0;
+        for (int w = 0; w < run->workerCount; w++) {
+            const BatchWorkerStats *stats = &run->stats[w];
+            if (stats->node != node || stats->seconds <= 0.0) continue;
+            nodeRate += stats->ticks / stats->seconds;
+            nodeWorkers++;
+        }
+        if (nodeWorkers == 0) continue;
+        total += nodeRate;
+        fprintf(out, "node %d: %d workers, %.0f ticks/s, %.2fx scaling\n", node, nodeWorkers, nodeRate, nodeRate / perWorker);
+    }
+    fprintf(out, "total: %d workers, %.0f ticks/s, %.2fx scaling\n", measured, total, total / perWorker);
+}
+
+void PrintBatchResults(const BatchRun *run, FILE *out) {
+    fprintf(out, "seed,strategy,victory,wave,health,money,ticks,estimated\n");
+    for (int i = 0; i < run->count; i++) {
+        const BatchResult *r = &run->results[i];
+        if (!r->done) continue; // The worker died
+        fprintf(out, "%u,%s,%d,%d,%d,%d,%u,%d\n", r->seed, g_strategyNames[r->strategy], r->victory, r->waveReached, r->playerHealth, r->playerMoney, r->ticks, r->estimated);
+    }
+}
+
+// Headless tool: plays gameCount games on the loaded map with consecutive seeds
+int RunBatchTool(int gameCount, uint32_t firstSeed, int strategy, int workerCount) {
+    BatchScenario *scenarios = malloc(gameCount * sizeof(BatchScenario));
+    if (!scenarios) return 1;
+    for (int i = 0; i < gameCount; i++) scenarios[i] = (BatchScenario){firstSeed + i, (uint8_t)strategy, 0, g_balance};
+    BatchRun *run = RunBatch(scenarios, gameCount, workerCount);
+    free(scenarios);
+    if (!run) {
+        printf("Failed to map the batch result table\n");
+        return 1;
+    }
+    PrintBatchResults(run, stdout);
+    PrintBatchReport(run, stderr);
+    FreeBatchRun(run);
+    return 0;
+}
+
+// --- Outcome Estimation ---
+// Predicts a batch game without simulating its waves, so sweeps can spend full simulations on
+// the games that are close. The bot still takes its real turns; only the waves are estimated.
+// A wave is worked out from tower coverage intervals in one pass. Slow towers stretch the time
+// enemies take to cross the parts of the path they cover, which fixes when every enemy enters
+// and leaves every other tower's intervals. Each damage tower is then a server with a fixed DPS
+// that works through enemies in the order they enter its range, one at a time, and splash and
+// chain towers serve faster the more tightly the stream is packed. Health left over leaks.
+// The estimate ignores shot travel, lane spreading and the tail of slows past a frost tower, so
+// a game is only trusted to it when runs with tower damage ESTIMATE_MARGIN lower and higher
+// end the same way. Everything else is simulated and the estimate scored against it.
+
+// A damage tower, placed along the path by where its coverage first begins
+typedef struct {
+    double start;
+    int x, y;
+} EstimateServer;
+
+// One enemy entering one of a server's coverage intervals
+typedef struct {
+    double time, leave;
+    int index;
+} EstimateEntry;
+
+static int CompareEstimateServers(const void *a, const void *b) {
+    double da = ((const EstimateServer *)a)->start, db = ((const EstimateServer *)b)->start;
+    return (da > db) - (da < db);
+}
+
+static int CompareEstimateEntries(const void *a, const void *b) {
+    const EstimateEntry *ea = a, *eb = b;
+    if (ea->time != eb->time) return (ea->time > eb->time) - (ea->time < eb->time);
+    return ea->index - eb->index;
+}
+
+static int CompareDoubles(const void *a, const void *b) {
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+// Seconds a one-node-per-second enemy needs to reach each path distance under every frost tower
+typedef struct {
+    double distance[2 * GRID_SIZE * GRID_SIZE * MAX_COVERAGE_INTERVALS + 2];
+    double time[2 * GRID_SIZE * GRID_SIZE * MAX_COVERAGE_INTERVALS + 2];
+    int count;
+} SlowProfile;
+
+static void BuildSlowProfile(SlowProfile *profile) {
+    double *breaks = profile->distance;
+    int count = 0;
+    breaks[count++] = 0.0;
+    breaks[count++] = pathLength - 1;
+    for (int x = 0; x < GRID_SIZE; x++) {
+        for (int y = 0; y < GRID_SIZE; y++) {
+            if (!towers[x][y].active || towers[x][y].type != TOWER_SLOW) continue;
+            const TowerCoverage *coverage = GetTowerCoverage(x, y);
+            for (int i = 0; i < coverage->count; i++) {
+                breaks[count++] = FxToFloat(coverage->intervals[i].start);
+                breaks[count++] = FxToFloat(coverage->intervals[i].end);
+            }
+        }
+    }
+    qsort(breaks, count, sizeof(double), CompareDoubles);
+
+    // The strongest frost tower covering the middle of each piece sets its speed
+    int kept = 0;
+    profile->time[0] = 0.0;
+    for (int i = 0; i < count; i++) {
+        if (breaks[i] < 0.0 || breaks[i] > pathLength - 1 || (kept > 0 && breaks[i] <= breaks[kept - 1])) continue;
+        if (kept > 0) {
+            double from = breaks[kept - 1], middle = 0.5 * (from + breaks[i]);
+            fixed_t factor = FX_ONE;
+            for (int x = 0; x < GRID_SIZE; x++) {
+                for (int y = 0; y < GRID_SIZE; y++) {
+                    const Tower *tower = &towers[x][y];
+                    if (!tower->active || tower->type != TOWER_SLOW) continue;
+                    fixed_t slow = g_towerStats[TOWER_SLOW][tower->level].damage;
+                    if (slow < factor && IsInCoverage(GetTowerCoverage(x, y), FX(middle))) factor = slow;
+                }
+            }
+            profile->time[kept] = profile->time[kept - 1] + (breaks[i] - from) / FxToFloat(factor > 0 ? factor : 1);
+        }
+        breaks[kept++] = breaks[i];
+    }
+    profile->count = kept;
+}
+
+// Unit-speed seconds to reach a path distance, and the slow factor there
+static double GetSlowProfileTime(const SlowProfile *profile, double distance, double *factor) {
+    int low = 0, high = profile->count - 1;
+    while (high - low > 1) {
+        int middle = (low + high) / 2;
+        if (profile->distance[middle] <= distance) low = middle;
+        else high = middle;
+    }
+    double span = profile->distance[high] - profile->distance[low];
+    double stretch = span > 0.0 ? (profile->time[high] - profile->time[low]) / span : 1.0;
+    if (factor) *factor = 1.0 / stretch;
+    return profile->time[low] + (distance - profile->distance[low]) * stretch;
+}
+
+// How many times faster than single-target a splash or chain tower gets through a stream
+// whose enemies are `spacing` pixels apart
+static double GetCrowdMultiplier(const TowerLevelStats *stats, int type, double spacing) {
+    if (spacing <= 0.0) return 1.0;
+    double radius = FxToFloat(stats->splashRadius);
+    if (type == TOWER_SPLASH) return 1.0 + (int)(2.0 * radius / spacing); // The blast covers a diameter of the stream
+    if (type != TOWER_CHAIN) return 1.0;
+    // Each jump must land within the bounce radius of the last hit, and the next enemy along is
+    // `spacing` away, so the chain either walks the stream or stops at the first target
+    int jumps = spacing <= radius ? stats->chainTargets - 1 : 0;
+    double multiplier = 0.0, damage = 1.0;
+    for (int jump = 0; jump <= jumps; jump++) {
+        multiplier += damage;
+        damage *= FxToFloat(CHAIN_DAMAGE_FALLOFF);
+    }
+    return multiplier;
+}
+
+// Plays the active wave out on paper: pays bounties, takes leaks and sets the game state the
+// wave would end in. Returns the ticks it should take.
+static uint32_t EstimateWave(double damageScale) {
+    static SlowProfile profile;
+    static EstimateServer servers[GRID_SIZE * GRID_SIZE];
+    static EstimateEntry entries[MAX_COVERAGE_INTERVALS * MAX_ENEMIES_PER_WAVE];
+    double health[MAX_ENEMIES_PER_WAVE], spawnTime[MAX_ENEMIES_PER_WAVE], speed[MAX_ENEMIES_PER_WAVE];
+    double doneTime[MAX_ENEMIES_PER_WAVE], leakTimes[MAX_ENEMIES_PER_WAVE];
+    int count = activeWave.enemyCount;
+
+    BuildSlowProfile(&profile);
+    double endTime = GetSlowProfileTime(&profile, pathLength - 1, NULL);
+    for (int i = 0; i < count; i++) {
+        const Enemy *enemy = &activeWave.enemies[i];
+        health[i] = FxToFloat(enemy->maxHealth);
+        spawnTime[i] = (i + 1) * FxToFloat(SPAWN_INTERVAL);
+        speed[i] = FxToFloat(enemyTypes[enemy->type].speed);
+        doneTime[i] = spawnTime[i] + endTime / speed[i] + 1.0 / SIM_TICKS_PER_SECOND; // Leaks the tick after the last node
+    }
+
+    int serverCount = 0;
+    for (int x = 0; x < GRID_SIZE; x++) {
+        for (int y = 0; y < GRID_SIZE; y++) {
+            if (!towers[x][y].active || towers[x][y].type == TOWER_SLOW) continue;
+            const TowerCoverage *coverage = GetTowerCoverage(x, y);
+            if (coverage->count > 0) servers[serverCount++] = (EstimateServer){FxToFloat(coverage->intervals[0].start), x, y};
+        }
+    }
+    qsort(servers, serverCount, sizeof(EstimateServer), CompareEstimateServers);
+
+    for (int n = 0; n < serverCount; n++) {
+        const Tower *tower = &towers[servers[n].x][servers[n].y];
+        const TowerLevelStats *stats = &g_towerStats[tower->type][tower->level];
+        const TowerCoverage *coverage = GetTowerCoverage(servers[n].x, servers[n].y);
+        double dps = FxToFloat(stats->damage) * FxToFloat(stats->fireRate) * damageScale;
+        int entryCount = 0;
+        double factor = 1.0;
+        for (int c = 0; c < coverage->count; c++) {
+            double enterTime = GetSlowProfileTime(&profile, FxToFloat(coverage->intervals[c].start), c == 0 ? &factor : NULL);
+            double exitTime = GetSlowProfileTime(&profile, FxToFloat(coverage->intervals[c].end), NULL);
+            for (int i = 0; i < count; i++) {
+                if (health[i] > 0.0) entries[entryCount++] = (EstimateEntry){spawnTime[i] + enterTime / speed[i], spawnTime[i] + exitTime / speed[i], i};
+            }
+        }
+        qsort(entries, entryCount, sizeof(EstimateEntry), CompareEstimateEntries);
+
+        // First come, first served; a tower never splits its fire between two enemies
+        double busy = 0.0;
+        for (int e = 0; e < entryCount; e++) {
+            int i = entries[e].index;
+            double start = entries[e].time > busy ? entries[e].time : busy;
+            if (health[i] <= 0.0 || start >= entries[e].leave) continue;
+            double spacing = speed[i] * factor * FxToFloat(SPAWN_INTERVAL) * cellWidth;
+            double rate = dps * GetCrowdMultiplier(stats, tower->type, spacing);
+            if (rate * (entries[e].leave - start) >= health[i]) {
+                busy = start + health[i] / rate;
+                health[i] = 0.0;
+                doneTime[i] = busy;
+            } else {
+                health[i] -= rate * (entries[e].leave - start);
+                busy = entries[e].leave;
+            }
+        }
+    }
+
+    // Leaks land in time order, and the game stops at the one that empties the player's health
+    int leakCount = 0;
+    for (int i = 0; i < count; i++) {
+        if (health[i] > 0.0) leakTimes[leakCount++] = doneTime[i];
+    }
+    qsort(leakTimes, leakCount, sizeof(double), CompareDoubles);
+    double waveEnd = 0.0;
+    for (int i = 0; i < count; i++) waveEnd = doneTime[i] > waveEnd ? doneTime[i] : waveEnd;
+    if (leakCount >= playerHealth && playerHealth > 0) {
+        waveEnd = leakTimes[playerHealth - 1];
+        playerHealth = 0;
+        gameState = GAME_STATE_GAME_OVER;
+    } else {
+        playerHealth -= leakCount;
+        gameState = currentWaveNumber >= MAX_WAVES ? GAME_STATE_VICTORY : GAME_STATE_WAVE_TRANSITION;
+    }
+    for (int i = 0; i < count; i++) {
+        if (health[i] <= 0.0 && doneTime[i] <= waveEnd) playerMoney += enemyTypes[activeWave.enemies[i].type].money;
+    }
+    return (uint32_t)ceil(waveEnd * SIM_TICKS_PER_SECOND);
+}
+
+// Plays a batch game with every wave estimated and tower damage scaled by damageScale
+void EstimateBatchGame(const BatchScenario *scenario, fixed_t damageScale, BatchResult *result) {
+    PrepareBatchGame(scenario);
+    uint32_t rng = scenario->seed ? scenario->seed : 1;
+    while (simTick < BATCH_MAX_TICKS && gameState == GAME_STATE_WAVE_TRANSITION) {
+        RunStrategyTurn(scenario->strategy, &rng);
+        ApplyCommand(&(GameCommand){CMD_START_WAVE, 0, 0, 0});
+        simTick += EstimateWave(FxToFloat(damageScale));
+    }
+    RecordBatchResult(scenario, result);
+    result->estimated = 1;
+}
+
+static void ScoreEstimate(EstimateScore *score, const BatchResult *estimate, const BatchResult *simulated) {
+    score->games++;
+    score->outcomeMatches += estimate->victory == simulated->victory && estimate->waveReached == simulated->waveReached;
+    score->waveError += abs(estimate->waveReached - simulated->waveReached);
+    score->healthError += abs(estimate->playerHealth - simulated->playerHealth);
+}
+
+// Runs one batch game, or with g_prescreen estimates it and simulates only if the estimate is close
+void PlayBatchScenario(const BatchScenario *scenario, BatchResult *result, BatchWorkerStats *stats) {
+    if (!g_prescreen) {
+        RunBatchGame(scenario, result);
+        return;
+    }
+    BatchResult low, high, estimate;
+    double startTime = GetWallSeconds();
+    EstimateBatchGame(scenario, FX_ONE - ESTIMATE_MARGIN, &low);
+    EstimateBatchGame(scenario, FX_ONE + ESTIMATE_MARGIN, &high);
+    EstimateBatchGame(scenario, FX_ONE, &estimate);
+    stats->estimateSeconds += GetWallSeconds() - startTime;
+    bool clear = low.victory == high.victory && low.waveReached == high.waveReached;
+    bool audit = scenario->seed % ESTIMATE_AUDIT_INTERVAL == 0;
+    if (clear && !audit) {
+        *result = estimate;
+        stats->estimatedGames++;
+        return;
+    }
+    RunBatchGame(scenario, result);
+    ScoreEstimate(clear ? &stats->auditScore : &stats->closeScore, &estimate, result);
+}
+
+// How many games the estimate decided, and how far off it was wherever it was checked
+void PrintEstimateReport(const BatchRun *run, FILE *out) {
+    if (!g_prescreen) return;
+    int games = 0, estimated = 0;
+    double seconds = 0.0;
+    EstimateScore scores[2] = {0};
+    for (int w = 0; w < run->workerCount; w++) {
+        const BatchWorkerStats *stats = &run->stats[w];
+        games += stats->games;
+        estimated += stats->estimatedGames;
+        seconds += stats->estimateSeconds;
+        const EstimateScore *from[2] = {&stats->closeScore, &stats->auditScore};
+        for (int k = 0; k < 2; k++) {
+            scores[k].games += from[k]->games;
+            scores[k].outcomeMatches += from[k]->outcomeMatches;
+            scores[k].waveError += from[k]->waveError;
+            scores[k].healthError += from[k]->healthError;
+        }
+    }
+    fprintf(out, "prescreen: %d of %d games estimated, %d close, %d audited, %.3fs estimating\n", estimated, games, scores[0].games, scores[1].games, seconds);
+    const char *labels[2] = {"close", "audited"};
+    for (int k = 0; k < 2; k++) {
+        const EstimateScore *score = &scores[k];
+        if (score->games == 0) continue;
+        fprintf(out, "estimate vs simulation, %s games: outcome agrees %.1f%%, mean wave error %.2f, mean health error %.2f\n", labels[k],
+                100.0 * score->outcomeMatches / score->games, (double)score->waveError / score->games, (double)score->healthError / score->games);
+    }
+}
+
+// --- Autosave ---
+// Every AUTOSAVE_INTERVAL seconds the frame loop copies the world into a pending SaveFile
+// between sim ticks. A writer thread writes it to a temp file, syncs it and renames it over
+// the previous save, so a crash leaves either the old save or the new one, never a torn mix.
+// The frame loop only ever trylocks; if the writer is busy the save is retried next frame.
+
+static uint32_t HashBytes(const void *data, size_t size) {
+    const uint8_t *bytes = data;
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
+
+static void *AutosaveWriterThread(void *arg) {
+    (void)arg;
+    static SaveFile save; // Only touched by this thread
+    char tempPath[512];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", autosaver.path);
+    for (;;) {
+        pthread_mutex_lock(&autosaver.lock);
+        while (!autosaver.hasPending && !autosaver.closing) pthread_cond_wait(&autosaver.wake, &autosaver.lock);
+        if (!autosaver.hasPending) { // Closing and nothing left to write
+            pthread_mutex_unlock(&autosaver.lock);
+            return NULL;
+        }
+        memcpy(&save, &autosaver.pending, sizeof(save)); // Padding included, the checksum covers it
+        autosaver.hasPending = false;
+        pthread_mutex_unlock(&autosaver.lock);
+
+        save.checksum = HashBytes(&save, offsetof(SaveFile, checksum));
+        FILE *file = fopen(tempPath, "wb");
+        if (!file) continue;
+        bool ok = fwrite(&save, sizeof(save), 1, file) == 1 && fflush(file) == 0 && fsync(fileno(file)) == 0;
+        ok = fclose(file) == 0 && ok;
+        if (ok) rename(tempPath, autosaver.path);
+        else remove(tempPath);
+    }
+}
+
+bool StartAutosave(const char *path, Vector2 startPos, Vector2 endPos) {
+    autosaver.path = path;
+    autosaver.startPos = startPos;
+    autosaver.endPos = endPos;
+    autosaver.timer = 0.0f;
+    pthread_mutex_init(&autosaver.lock, NULL);
+    pthread_cond_init(&autosaver.wake, NULL);
+    if (pthread_create(&autosaver.writer, NULL, AutosaveWriterThread, NULL) != 0) return false;
+    autosaver.enabled = true;
+    return true;
+}
+
+// Must be called between sim ticks. Returns false if the writer held the lock.
+static bool QueueAutosave(bool wait) {
+    if (wait) pthread_mutex_lock(&autosaver.lock);
+    else if (pthread_mutex_trylock(&autosaver.lock) != 0) return false;
+    SaveFile *save = &autosaver.pending;
+    memcpy(save->magic, AUTOSAVE_MAGIC, 4);
+    save->version = AUTOSAVE_VERSION;
+    save->gridSize = GRID_SIZE;
+    for (int x = 0; x < GRID_SIZE; x++) {
+        for (int y = 0; y < GRID_SIZE; y++) save->walls[x][y] = walls[x][y];
+    }
+    save->startX = (int32_t)autosaver.startPos.x; save->startY = (int32_t)autosaver.startPos.y;
+    save->endX = (int32_t)autosaver.endPos.x; save->endY = (int32_t)autosaver.endPos.y;
+    save->gameSpeed = gameSpeed;
+    CaptureSnapshot(&save->snapshot);
+    autosaver.hasPending = true;
+    pthread_cond_signal(&autosaver.wake);
+    pthread_mutex_unlock(&autosaver.lock);
+    return true;
+}
+
+// A finished run is not worth resuming
+static bool RunHasEnded() {
+    return gameState == GAME_STATE_GAME_OVER || gameState == GAME_STATE_VICTORY;
+}
+
+void UpdateAutosave(float dt) {
+    if (!autosaver.enabled || RunHasEnded()) return;
+    autosaver.timer += dt;
+    if (autosaver.timer >= AUTOSAVE_INTERVAL && QueueAutosave(false)) autosaver.timer = 0.0f;
+}
+
+// Writes the final state and waits for the writer to finish. A run that has ended deletes its
+// save instead, so the next --resume does not reopen on the end screen.
+void StopAutosave() {
+    if (!autosaver.enabled) return;
+    bool ended = RunHasEnded();
+    if (!ended) QueueAutosave(true);
+    pthread_mutex_lock(&autosaver.lock);
+    autosaver.closing = true;
+    pthread_cond_signal(&autosaver.wake);
+    pthread_mutex_unlock(&autosaver.lock);
+    pthread_join(autosaver.writer, NULL);
+    pthread_mutex_destroy(&autosaver.lock);
+    pthread_cond_destroy(&autosaver.wake);
+    if (ended) remove(autosaver.path);
+    autosaver.enabled = false;
+}
+
+// Loads a save's map into walls/path. The rest is applied by ApplyAutosave once the game is initialized.
+bool LoadAutosave(const char *path, SaveFile *save, Vector2 *startPos, Vector2 *endPos) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return false;
+    bool ok = fread(save, sizeof(*save), 1, file) == 1;
+    fclose(file);
+    if (!ok || memcmp(save->magic, AUTOSAVE_MAGIC, 4) != 0 || save->version != AUTOSAVE_VERSION || save->gridSize != GRID_SIZE ||
+        save->checksum != HashBytes(save, offsetof(SaveFile, checksum))) {
+        printf("Ignoring invalid autosave: %s\n", path);
+        return false;
+    }
+    for (int x = 0; x < GRID_SIZE; x++) {
+        for (int y = 0; y < GRID_SIZE; y++) walls[x][y] = save->walls[x][y];
+    }
+    *startPos = (Vector2){(float)save->startX, (float)save->startY};
+    *endPos = (Vector2){(float)save->endX, (float)save->endY};
+    return FindPathBFS(*startPos, *endPos);
+}
+
+void ApplyAutosave(const SaveFile *save) {
+    RestoreSnapshot(&save->snapshot);
+    gameSpeed = save->gameSpeed;
+}
+
+// --- Sweeps ---
+// A manifest describes a grid of work units: every map x strategy x stat combination x seed.
+//   map maps/spiral.txt
+//   strategy upgrade
+//   seeds 1 200                   (first seed, count)
+//   stat tower_damage 0.8 1.2 5   (min, max, steps)
+// Units are numbered map-major with the seed varying fastest, and shard k of N owns every unit
+// whose number is k mod N. A shard appends one line per finished unit to its own result file
+// and syncs after every chunk, so a restarted node skips what is already on disk. Only
+// complete lines count; a line torn by a crash is ignored and its unit runs again.
+
+const char *g_balanceStatNames[BALANCE_STAT_COUNT] = {"tower_damage", "tower_cost", "enemy_health", "enemy_speed"};
+
+static void FreeSweepManifest(SweepManifest *manifest) {
+    free(manifest->maps);
+    memset(manifest, 0, sizeof(*manifest));
+}
+
+bool LoadSweepManifest(const char *filename, SweepManifest *manifest) {
+    memset(manifest, 0, sizeof(*manifest));
+    for (int s = 0; s < BALANCE_STAT_COUNT; s++) {
+        manifest->statMin[s] = manifest->statMax[s] = FX_ONE;
+        manifest->statSteps[s] = 1;
+    }
+    manifest->seedCount = 1;
+    manifest->firstSeed = 1;
+
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        printf("Failed to open sweep manifest: %s\n", filename);
+        return false;
+    }
+    char line[512], word[256];
+    uint32_t hash = 2166136261u;
+    int lineNumber = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        hash = (hash ^ HashBytes(line, strlen(line))) * 16777619u;
+        if (sscanf(line, "%255s", word) != 1 || word[0] == '#') continue;
+
+        if (strcmp(word, "map") == 0) {
+            char path[256];
+            Vector2 start, end;
+            if (sscanf(line, "%*s %255s", path) != 1 || !LoadMap(path, &start, &end) || !FindPathBFS(start, end)) {
+                ok = false;
+                break;
+            }
+            MapData *grown = realloc(manifest->maps, (manifest->mapCount + 1) * sizeof(MapData));
+            if (!grown) { ok = false; break; }
+            manifest->maps = grown;
+            MapData *map = &manifest->maps[manifest->mapCount++];
+            for (int x = 0; x < GRID_SIZE; x++) {
+                for (int y = 0; y < GRID_SIZE; y++) map->walls[x][y] = walls[x][y];
+            }
+            map->start = start;
+            map->end = end;
+            snprintf(map->name, sizeof(map->name), "%s", path);
+        } else if (strcmp(word, "strategy") == 0) {
+            int strategy = sscanf(line, "%*s %255s", word) == 1 ? FindStrategy(word) : -1;
+            if (strategy < 0 || manifest->strategyCount == STRATEGY_COUNT) { ok = false; break; }
+            manifest->strategies[manifest->strategyCount++] = (uint8_t)strategy;
+        } else if (strcmp(word, "seeds") == 0) {
+            if (sscanf(line, "%*s %u %u", &manifest->firstSeed, &manifest->seedCount) != 2 || manifest->seedCount == 0) { ok = false; break; }
+        } else if (strcmp(word, "stat") == 0) {
+            double min, max;
+            int steps, stat = -1;
+            if (sscanf(line, "%*s %255s %lf %lf %d", word, &min, &max, &steps) != 4 || steps < 1) { ok = false; break; }
+            for (int s = 0; s < BALANCE_STAT_COUNT; s++) {
+                if (strcmp(word, g_balanceStatNames[s]) == 0) stat = s;
+            }
+            if (stat < 0) { ok = false; break; }
+            manifest->statMin[stat] = FX(min); // strtod rounds correctly, so every node gets the same bits
+            manifest->statMax[stat] = FX(max);
+            manifest->statSteps[stat] = steps;
+        } else {
+            ok = false;
+        }
+    }
+    fclose(file);
+    if (ok && manifest->strategyCount == 0) manifest->strategies[manifest->strategyCount++] = STRATEGY_RANDOM;
+    if (!ok || manifest->mapCount == 0) {
+        printf("Invalid sweep manifest %s at line %d\n", filename, lineNumber);
+        FreeSweepManifest(manifest);
+        return false;
+    }
+    manifest->hash = hash;
+    manifest->unitCount = (uint64_t)manifest->mapCount * manifest->strategyCount * manifest->seedCount;
+    for (int s = 0; s < BALANCE_STAT_COUNT; s++) manifest->unitCount *= manifest->statSteps[s];
+    return true;
+}
+
+// Unpacks a unit number into the scenario it stands for
+static BatchScenario GetSweepScenario(const SweepManifest *manifest, uint64_t unit) {
+    BatchScenario scenario = {0};
+    scenario.seed = manifest->firstSeed + (uint32_t)(unit % manifest->seedCount);
+    unit /= manifest->seedCount;
+    for (int s = BALANCE_STAT_COUNT - 1; s >= 0; s--) {
+        int steps = manifest->statSteps[s];
+        int step = (int)(unit % steps);
+        unit /= steps;
+        fixed_t range = manifest->statMax[s] - manifest->statMin[s];
+        scenario.balance.scale[s] = manifest->statMin[s] + (steps > 1 ? (fixed_t)((int64_t)range * step / (steps - 1)) : 0);
+    }
+    scenario.strategy = manifest->strategies[unit % manifest->strategyCount];
+    scenario.mapIndex = (uint16_t)(unit / manifest->strategyCount);
+    return scenario;
+}
+
+// Parses one result line. Returns false for comments and torn or malformed lines.
+static bool ParseSweepLine(const char *line, uint64_t *unit, BatchResult *result) {
+    size_t length = strlen(line);
+    if (length == 0 || line[length - 1] != '\n' || line[0] == '#') return false;
+    unsigned long long unitNumber;
+    int victory, estimated = 0; // Lines written before prescreening existed have no estimated flag
+    if (sscanf(line, "%llu %u %d %d %d %d %u %d", &unitNumber, &result->seed, &victory, &result->waveReached,
+               &result->playerHealth, &result->playerMoney, &result->ticks, &estimated) < 7) return false;
+    *unit = unitNumber;
+    result->victory = (uint8_t)victory;
+    result->estimated = (uint8_t)estimated;
+    result->done = 1;
+    return true;
+}
+
+// Reads a shard's result file, marking finished units. Returns false if it belongs to another manifest.
+static bool ReadSweepResults(const char *filename, const SweepManifest *manifest, uint8_t *finished, BatchResult *results, bool *endsWithNewline) {
+    *endsWithNewline = true;
+    FILE *file = fopen(filename, "r");
+    if (!file) return true; // Nothing done yet
+    char line[256];
+    bool ok = true;
+    while (fgets(line, sizeof(line), file)) {
+        unsigned int hash;
+        if (sscanf(line, "# sweep %x", &hash) == 1 && hash != manifest->hash) {
+            printf("%s was written for a different manifest\n", filename);
+            ok = false;
+            break;
+        }
+        uint64_t unit;
+        BatchResult result;
+        if (ParseSweepLine(line, &unit, &result) && unit < manifest->unitCount) {
+            finished[unit] = 1;
+            if (results) results[unit] = result;
+        }
+        *endsWithNewline = line[strlen(line) - 1] == '\n';
+    }
+    fclose(file);
+    return ok;
+}
+
+// Runs the units of one shard that are not already in outPath
+int RunSweepShard(const char *manifestPath, int shardIndex, int shardCount, const char *outPath, int workerCount) {
+    SweepManifest manifest;
+    if (!LoadSweepManifest(manifestPath, &manifest)) return 1;
+    uint8_t *finished = calloc(manifest.unitCount, 1);
+    bool endsWithNewline;
+    if (!finished || !ReadSweepResults(outPath, &manifest, finished, NULL, &endsWithNewline)) {
+        free(finished);
+        FreeSweepManifest(&manifest);
+        return 1;
+    }
+
+    FILE *out = fopen(outPath, "a");
+    if (!out) {
+        printf("Failed to open sweep results for appending: %s\n", outPath);
+        free(finished);
+        FreeSweepManifest(&manifest);
+        return 1;
+    }
+    if (!endsWithNewline) fputc('\n', out); // Fence off a torn last line
+    fseek(out, 0, SEEK_END);
+    if (ftell(out) == 0) fprintf(out, "# sweep %08x shard %d/%d\n", manifest.hash, shardIndex, shardCount);
+
+    int chunkSize = (workerCount > 0 ? workerCount : (int)sysconf(_SC_NPROCESSORS_ONLN)) * SWEEP_GAMES_PER_WORKER;
+    BatchScenario *scenarios = malloc(chunkSize * sizeof(BatchScenario));
+    uint64_t *units = malloc(chunkSize * sizeof(uint64_t));
+    g_batchMaps = manifest.maps;
+    uint64_t ran = 0, skipped = 0;
+    for (uint64_t unit = shardIndex; scenarios && units && unit < manifest.unitCount;) {
+        int count = 0;
+        for (; unit < manifest.unitCount && count < chunkSize; unit += shardCount) {
+            if (finished[unit]) { skipped++; continue; }
+            units[count] = unit;
+            scenarios[count++] = GetSweepScenario(&manifest, unit);
+        }
+        if (count == 0) break;
+        BatchRun *run = RunBatch(scenarios, count, workerCount);
+        if (!run) break;
+        for (int i = 0; i < count; i++) {
+            const BatchResult *r = &run->results[i];
+            if (!r->done) continue; // Picked up again on the next attempt
+            fprintf(out, "%llu %u %d %d %d %d %u %d\n", (unsigned long long)units[i], r->seed, r->victory, r->waveReached, r->playerHealth, r->playerMoney, r->ticks, r->estimated);
+            ran++;
+        }
+        PrintEstimateReport(run, stderr);
+        FreeBatchRun(run);
+        fflush(out);
+        fsync(fileno(out)); // A chunk is only finished once it is on the shared disk
+        fprintf(stderr, "shard %d/%d: %llu units run, %llu already done\n", shardIndex, shardCount, (unsigned long long)ran, (unsigned long long)skipped);
+    }
+    g_batchMaps = NULL;
+    fclose(out);
+    free(scenarios);
+    free(units);
+    free(finished);
+    FreeSweepManifest(&manifest);
+    return 0;
+}
+
+// Combines shard result files into one CSV in unit order
+int MergeSweepResults(const char *manifestPath, char **resultPaths, int resultCount) {
+    SweepManifest manifest;
+    if (!LoadSweepManifest(manifestPath, &manifest)) return 1;
+    uint8_t *finished = calloc(manifest.unitCount, 1);
+    BatchResult *results = malloc(manifest.unitCount * sizeof(BatchResult));
+    bool ok = finished && results;
+    for (int i = 0; ok && i < resultCount; i++) {
+        bool endsWithNewline;
+        ok = ReadSweepResults(resultPaths[i], &manifest, finished, results, &endsWithNewline);
+    }
+    if (ok) {
+        uint64_t complete = 0;
+        printf("unit,map,strategy");
+        for (int s = 0; s < BALANCE_STAT_COUNT; s++) printf(",%s", g_balanceStatNames[s]);
+        printf(",seed,victory,wave,health,money,ticks,estimated\n");
+        for (uint64_t unit = 0; unit < manifest.unitCount; unit++) {
+            if (!finished[unit]) continue;
+            BatchScenario scenario = GetSweepScenario(&manifest, unit);
+            const BatchResult *r = &results[unit];
+            printf("%llu,%s,%s", (unsigned long long)unit, manifest.maps[scenario.mapIndex].name, g_strategyNames[scenario.strategy]);
+            for (int s = 0; s < BALANCE_STAT_COUNT; s++) printf(",%.4f", FxToFloat(scenario.balance.scale[s]));
+            printf(",%u,%d,%d,%d,%d,%u,%d\n", r->seed, r->victory, r->waveReached, r->playerHealth, r->playerMoney, r->ticks, r->estimated);
+            complete++;
+        }
+        fprintf(stderr, "%llu of %llu units complete\n", (unsigned long long)complete, (unsigned long long)manifest.unitCount);
+    }
+    free(finished);
+    free(results);
+    FreeSweepManifest(&manifest);
+    return ok ? 0 : 1;
+}
+
+// --- Video Export ---
+// Renders a replay offscreen at a fixed frame rate and streams it as Y4M or a PNG sequence.
+// The main thread only simulates, draws into a render texture and reads the pixels back.
+// Encoder threads turn captured frames into Y4M planes or PNG bytes in parallel, and a writer
+// thread writes them out in frame order. Frames move through a ring of VIDEO_PIPELINE_DEPTH
+// slots; the renderer only waits when every slot is still in flight.
+
+// RGBA rows come back bottom-up from the render texture. Full-range BT.601, 4:2:0.
+static uint8_t *EncodeY4MFrame(const Image *frame, size_t *size) {
+    int w = frame->width, h = frame->height;
+    *size = 6 + (size_t)w * h + 2 * (size_t)(w / 2) * (h / 2);
+    uint8_t *out = malloc(*size);
+    if (!out) return NULL;
+    memcpy(out, "FRAME\n", 6);
+    const uint8_t *rgba = frame->data;
+    uint8_t *yPlane = out + 6, *uPlane = yPlane + w * h, *vPlane = uPlane + (w / 2) * (h / 2);
+    for (int y = 0; y < h; y++) {
+        const uint8_t *row = rgba + (size_t)(h - 1 - y) * w * 4;
+        for (int x = 0; x < w; x++) {
+            const uint8_t *p = row + x * 4;
+            yPlane[y * w + x] = (uint8_t)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+        }
+    }
+    for (int y = 0; y < h / 2; y++) {
+        const uint8_t *row0 = rgba + (size_t)(h - 1 - 2 * y) * w * 4, *row1 = row0 - (size_t)w * 4;
+        for (int x = 0; x < w / 2; x++) {
+            const uint8_t *a = row0 + x * 8, *b = row1 + x * 8;
+            int r = (a[0] + a[4] + b[0] + b[4] + 2) >> 2;
+            int g = (a[1] + a[5] + b[1] + b[5] + 2) >> 2;
+            int bl = (a[2] + a[6] + b[2] + b[6] + 2) >> 2;
+            uPlane[y * (w / 2) + x] = (uint8_t)((-43 * r - 85 * g + 128 * bl + 32768 + 128) >> 8); // +32768 keeps it non-negative
+            vPlane[y * (w / 2) + x] = (uint8_t)((128 * r - 107 * g - 21 * bl + 32768 + 128) >> 8);
+        }
+    }
+    return out;
+}
+
+static void *VideoEncoderThread(void *arg) {
+    VideoExporter *video = arg;
+    pthread_mutex_lock(&video->lock);
+    for (;;) {
+        VideoSlot *slot = NULL;
+        for (int i = 0; i < VIDEO_PIPELINE_DEPTH && !slot; i++) {
+            if (video->slots[i].state == VIDEO_SLOT_CAPTURED) slot = &video->slots[i];
+        }
+        if (!slot) {
+            if (video->closing) break;
+            pthread_cond_wait(&video->changed, &video->lock);
+            continue;
+        }
+        slot->state = VIDEO_SLOT_ENCODING;
+        pthread_mutex_unlock(&video->lock);
+
+        if (video->file) {
+            slot->encoded = EncodeY4MFrame(&slot->frame, &slot->encodedSize);
+        } else {
+            int size = 0;
+            ImageFlipVertical(&slot->frame);
+            slot->encoded = ExportImageToMemory(slot->frame, ".png", &size);
+            slot->encodedSize = size;
+        }
+
+        pthread_mutex_lock(&video->lock);
+        slot->state = VIDEO_SLOT_ENCODED;
+        pthread_cond_broadcast(&video->changed);
+    }
+    pthread_mutex_unlock(&video->lock);
+    return NULL;
+}
+
+static void *VideoWriterThread(void *arg) {
+    VideoExporter *video = arg;
+    if (video->file) fprintf(video->file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", video->width, video->height, video->fps);
+    pthread_mutex_lock(&video->lock);
+    for (;;) {
+        VideoSlot *slot = &video->slots[video->framesWritten % VIDEO_PIPELINE_DEPTH];
+        if (video->framesWritten == video->framesCaptured && video->closing) break;
+        if (video->framesWritten == video->framesCaptured || slot->state != VIDEO_SLOT_ENCODED) {
+            pthread_cond_wait(&video->changed, &video->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&video->lock);
+
+        if (!slot->encoded) {
+            video->failed = true;
+        } else if (video->file) {
+            if (fwrite(slot->encoded, 1, slot->encodedSize, video->file) != slot->encodedSize) video->failed = true;
+        } else {
+            char path[1024]; // Not TextFormat: its buffers are shared with the drawing thread
+            snprintf(path, sizeof(path), "%s/frame_%06d.png", video->pngDir, video->framesWritten);
+            FILE *png = fopen(path, "wb");
+            if (!png || fwrite(slot->encoded, 1, slot->encodedSize, png) != slot->encodedSize) video->failed = true;
+            if (png) fclose(png);
+        }
+        if (video->file) free(slot->encoded);
+        else MemFree(slot->encoded);
+        UnloadImage(slot->frame);
+
+        pthread_mutex_lock(&video->lock);
+        slot->encoded = NULL;
+        slot->state = VIDEO_SLOT_FREE;
+        video->framesWritten++;
+        pthread_cond_broadcast(&video->changed);
+    }
+    pthread_mutex_unlock(&video->lock);
+    return NULL;
+}
+
+// outPath ending in .y4m writes one Y4M stream; anything else is a directory for frame_NNNNNN.png files
+bool StartVideoExport(VideoExporter *video, const char *outPath, int width, int height, int fps) {
+    memset(video, 0, sizeof(*video));
+    video->width = width;
+    video->height = height;
+    video->fps = fps;
+    if (IsFileExtension(outPath, ".y4m")) {
+        video->file = fopen(outPath, "wb");
+        if (!video->file) {
+            printf("Failed to open video file for writing: %s\n", outPath);
+            return false;
+        }
+    } else {
+        mkdir(outPath, 0755); // Fine if it already exists
+        video->pngDir = outPath;
+    }
+    pthread_mutex_init(&video->lock, NULL);
+    pthread_cond_init(&video->changed, NULL);
+    for (int i = 0; i < VIDEO_ENCODER_THREADS; i++) pthread_create(&video->encoders[i], NULL, VideoEncoderThread, video);
+    pthread_create(&video->writer, NULL, VideoWriterThread, video);
+    return true;
+}
 
-    if (g_isPaused) return; // Stop game logic updates if paused
+// Takes ownership of the frame
+void SubmitVideoFrame(VideoExporter *video, Image frame) {
+    pthread_mutex_lock(&video->lock);
+    VideoSlot *slot = &video->slots[video->framesCaptured % VIDEO_PIPELINE_DEPTH];
+    while (slot->state != VIDEO_SLOT_FREE) pthread_cond_wait(&video->changed, &video->lock);
+    slot->frame = frame;
+    slot->state = VIDEO_SLOT_CAPTURED;
+    video->framesCaptured++;
+    pthread_cond_broadcast(&video->changed);
+    pthread_mutex_unlock(&video->lock);
+}
 
-    dt *= gameSpeed; // Apply game speed multiplier
+// Drains the pipeline. Returns false if any frame failed to encode or write.
+bool FinishVideoExport(VideoExporter *video) {
+    pthread_mutex_lock(&video->lock);
+    video->closing = true;
+    pthread_cond_broadcast(&video->changed);
+    pthread_mutex_unlock(&video->lock);
+    for (int i = 0; i < VIDEO_ENCODER_THREADS; i++) pthread_join(video->encoders[i], NULL);
+    pthread_join(video->writer, NULL);
+    if (video->file) fclose(video->file);
+    pthread_mutex_destroy(&video->lock);
+    pthread_cond_destroy(&video->changed);
+    return !video->failed;
+}
 
-    switch (gameState) {
-        case GAME_STATE_PLAYING:
-            UpdateWave(&activeWave, dt);
-            UpdateEnemies(&activeWave, dt);
-            UpdateTowers(dt);
-            CheckWaveCompletion();
-            break;
-        case GAME_STATE_WAVE_TRANSITION:
-            // Handled by UI button now
-            break;
-        case GAME_STATE_GAME_OVER:
-            if (IsKeyPressed(KEY_R)) RestartGame();
-            break;
-        case GAME_STATE_VICTORY:
-            if (IsKeyPressed(KEY_R)) RestartGame();
-            break;
+// Headless tool: renders a whole replay, plus a second of the final state, to video
+int RunVideoTool(const char *replayPath, const char *outPath, int fps, float speed) {
+    if (fps <= 0) fps = 60;
+    if (!(speed > 0.0f)) speed = 1.0f; // The replay would never advance
+    SetConfigFlags(FLAG_WINDOW_HIDDEN); // Still needs a GL context: a display, Xvfb, or an EGL/DRM build of raylib
+    InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Tower Defense: Video Export");
+    if (!OpenReplay(replayPath, &replayViewer) || !LoadReplayMap(&replayViewer)) {
+        CloseWindow();
+        return 1;
+    }
+    InitializeGame();
+    g_muteSimSounds = true; // Popups stay on, the video shows them
+    gameSpeed = speed;
+    SeekReplay(&replayViewer, 0);
+
+    RenderTexture2D target = LoadRenderTexture(SCREEN_WIDTH, SCREEN_HEIGHT);
+    LoadSpriteAtlas();
+    LoadEffectShader();
+    LoadPopupGlyphs();
+    static VideoExporter video;
+    if (!StartVideoExport(&video, outPath, SCREEN_WIDTH, SCREEN_HEIGHT, fps)) {
+        CloseReplay(&replayViewer);
+        CloseWindow();
+        return 1;
+    }
+
+    float frameDt = 1.0f / fps;
+    float accumulator = 0.0f;
+    bool playing = true;
+    double startTime = GetWallSeconds();
+    for (int tailFrames = fps; playing || tailFrames-- > 0;) {
+        accumulator += frameDt * speed;
+        while (playing && accumulator >= SIM_TICK_SECONDS) {
+            accumulator -= SIM_TICK_SECONDS;
+            playing = StepReplay(&replayViewer);
+        }
+        g_renderDt = frameDt;
+        g_renderTime += frameDt;
+
+        UpdateBackground(g_cameraView);
+        UpdateMinimap();
+        BeginTextureMode(target);
+            DrawGameScene(frameDt * speed);
+            DrawGameUI();
+            DrawReplayTimeline();
+        EndTextureMode();
+        SubmitVideoFrame(&video, LoadImageFromTexture(target.texture));
     }
+
+    bool ok = FinishVideoExport(&video);
+    fprintf(stderr, "Rendered %d frames in %.2fs\n", video.framesWritten, GetWallSeconds() - startTime);
+    UnloadPopupGlyphs();
+    UnloadEffectShader();
+    UnloadSpriteAtlas();
+    UnloadRenderTexture(target);
+    UnloadMinimap();
+    UnloadBackground();
+    CloseReplay(&replayViewer);
+    CloseWindow();
+    return ok ? 0 : 1;
 }
 
 // --- Main Entry Point ---
-int main(void) {
+// Usage: tower_defense [--record out.tdr [--compress]] [--replay in.tdr] [--telemetry out.tdt] [--resume] [--map file]
+//        tower_defense --dump-telemetry in.tdt > out.csv
+//        tower_defense --branch in.tdr --at SECONDS [--horizon SECONDS] [--workers N] > ranking.csv
+//        tower_defense --batch GAMES [--seed N] [--strategy random|upgrade] [--map file] [--workers N] [--prescreen] > results.csv
+//        tower_defense --sweep manifest --shard K/N --out shardK.txt [--workers N] [--prescreen]
+//        tower_defense --merge-sweep manifest shard0.txt shard1.txt ... > sweep.csv
+//        tower_defense --video in.tdr --out out.y4m|frames_dir [--fps N] [--speed X]
+int main(int argc, char **argv) {
+    const char *recordPath = NULL;
+    const char *replayPath = NULL;
+    const char *branchPath = NULL;
+    bool compressReplay = false;
+    bool resume = false;
+    float branchAt = 0.0f, branchHorizon = 600.0f;
+    int workerCount = 0;
+    const char *mapPath = "map.txt";
+    int batchGames = 0, strategy = STRATEGY_RANDOM;
+    uint32_t firstSeed = 1;
+    const char *sweepPath = NULL, *sweepOut = NULL;
+    const char *videoPath = NULL;
+    int videoFps = 60;
+    float videoSpeed = 1.0f;
+    int shardIndex = 0, shardCount = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) recordPath = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) replayPath = argv[++i];
+        else if (strcmp(argv[i], "--compress") == 0) compressReplay = true;
+        else if (strcmp(argv[i], "--resume") == 0) resume = true; // Continue from the autosave instead of --map
+        else if (strcmp(argv[i], "--skip-idle") == 0) g_skipIdleTicks = true; // Batch, sweep and branch runs
+        else if (strcmp(argv[i], "--prescreen") == 0) g_prescreen = true; // Batch and sweep runs
+        else if (strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc) {
+            telemetry.enabled = true;
+            telemetry.filename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dump-telemetry") == 0 && i + 1 < argc) return DumpTelemetry(argv[++i]);
+        else if (strcmp(argv[i], "--branch") == 0 && i + 1 < argc) branchPath = argv[++i];
+        else if (strcmp(argv[i], "--at") == 0 && i + 1 < argc) branchAt = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--horizon") == 0 && i + 1 < argc) branchHorizon = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) workerCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) batchGames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) firstSeed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--map") == 0 && i + 1 < argc) mapPath = argv[++i];
+        else if (strcmp(argv[i], "--sweep") == 0 && i + 1 < argc) sweepPath = argv[++i];
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) sweepOut = argv[++i];
+        else if (strcmp(argv[i], "--video") == 0 && i + 1 < argc) videoPath = argv[++i];
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) videoFps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) videoSpeed = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--shard") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d/%d", &shardIndex, &shardCount) != 2 || shardCount < 1 || shardIndex < 0 || shardIndex >= shardCount) {
+                printf("Invalid shard, expected K/N: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--merge-sweep") == 0 && i + 1 < argc) return MergeSweepResults(argv[i + 1], argv + i + 2, argc - i - 2);
+        else if (strcmp(argv[i], "--strategy") == 0 && i + 1 < argc) {
+            strategy = FindStrategy(argv[++i]);
+            if (strategy < 0) {
+                printf("Unknown strategy: %s\n", argv[i]);
+                return 1;
+            }
+        }
+    }
+    if (branchPath) return RunBranchTool(branchPath, branchAt, branchHorizon, workerCount);
+    if (videoPath) return RunVideoTool(videoPath, sweepOut ? sweepOut : "replay.y4m", videoFps, videoSpeed);
+    if (sweepPath) {
+        char defaultOut[512]; // Not TextFormat: its buffers are reused while the shard runs
+        if (!sweepOut) {
+            snprintf(defaultOut, sizeof(defaultOut), "%s.shard%d", sweepPath, shardIndex);
+            sweepOut = defaultOut;
+        }
+        return RunSweepShard(sweepPath, shardIndex, shardCount, sweepOut, workerCount);
+    }
+    if (batchGames > 0) {
+        Vector2 start, end;
+        if (!LoadMap(mapPath, &start, &end) || !FindPathBFS(start, end)) {
+            printf("Map or path not valid: %s\n", mapPath);
+            return 1;
+        }
+        return RunBatchTool(batchGames, firstSeed, strategy, workerCount);
+    }
+
     InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Tower Defense: Evolved");
     SetTargetFPS(60);
 
     Vector2 startPos, endPos;
-    if (!LoadMap("map.txt", &startPos, &endPos) || !FindPathBFS(startPos, endPos)) {
+    static SaveFile save;
+    bool resumed = !replayPath && resume && LoadAutosave(AUTOSAVE_PATH, &save, &startPos, &endPos);
+    bool mapLoaded = replayPath ? (OpenReplay(replayPath, &replayViewer) && LoadReplayMap(&replayViewer))
+                                : (resumed || (LoadMap(mapPath, &startPos, &endPos) && FindPathBFS(startPos, endPos)));
+    if (!mapLoaded) {
         TraceLog(LOG_ERROR, "Map or Path not valid. Exiting.");
         CloseWindow();
         return 1;
     }
 
     InitializeGame();
+    if (resumed) ApplyAutosave(&save);
     LoadGameAudio();
-
-    RenderTexture2D backgroundTexture = LoadRenderTexture(GAME_AREA_WIDTH, SCREEN_HEIGHT);
-    BeginTextureMode(backgroundTexture);
-        ClearBackground(COLOR_BLACK);
-        for (int y = 0; y <= GRID_SIZE; y++) DrawLine(0, y * cellHeight, GAME_AREA_WIDTH, y * cellHeight, COLOR_BG_GRID);
-        for (int x = 0; x <= GRID_SIZE; x++) DrawLine(x * cellWidth, 0, x * cellWidth, SCREEN_HEIGHT, COLOR_BG_GRID);
-        for (int i = 0; i < pathLength - 1; i++) {
-            Vector2 p1 = {path[i].x * cellWidth + cellWidth/2, path[i].y * cellHeight + cellHeight/2};
-            Vector2 p2 = {path[i+1].x * cellWidth + cellWidth/2, path[i+1].y * cellHeight + cellHeight/2};
-            DrawLineEx(p1, p2, 10, COLOR_PATH);
-        }
-        for (int x = 0; x < GRID_SIZE; x++) {
-            for (int y = 0; y < GRID_SIZE; y++) {
-                if (walls[x][y]) DrawWall(x, y);
-            }
-        }
-    EndTextureMode();
+    LoadSpriteAtlas();
+    LoadEffectShader();
+    LoadPopupGlyphs();
+    if (replayPath) SeekReplay(&replayViewer, 0);
+    else {
+        if (recordPath) StartReplayRecording(recordPath, startPos, endPos, compressReplay);
+        StartAutosave(AUTOSAVE_PATH, startPos, endPos);
+    }
 
     while (!WindowShouldClose()) {
+        double frameStart = GetTime();
         float dt = GetFrameTime();
-        UpdateGame(dt);
+        g_renderDt = dt;
+        g_renderTime = frameStart;
+        if (replayViewer.data) UpdateReplayViewer(dt);
+        else {
+            UpdateGame(dt);
+            UpdateAutosave(dt); // Between ticks, so the save is consistent
+        }
         
+        UpdateBackground(g_cameraView);
+        UpdateMinimap();
         BeginDrawing();
-        ClearBackground(COLOR_BLACK);
-        DrawTextureRec(backgroundTexture.texture, (Rectangle){0, 0, (float)backgroundTexture.texture.width, (float)-backgroundTexture.texture.height}, (Vector2){0, 0}, WHITE);
-        
-        DrawEnemies(&activeWave);
-        DrawTowers();
-        UpdateAndDrawProjectiles(dt * (g_isPaused ? 0 : gameSpeed));
+        DrawGameScene(dt * (g_isPaused ? 0 : gameSpeed));
 
         // Draw placement/selection highlights
         Vector2 mousePos = GetMousePosition();
@@ -635,37 +4350,634 @@ int main(void) {
             if (g_selectedBuildType != -1 && walls[gridX][gridY] && !towers[gridX][gridY].active) {
                 Color highlightColor = (playerMoney >= g_towerStats[g_selectedBuildType][0].cost) ? COLOR_NEON_CYAN : COLOR_NEON_RED;
                 DrawRectangleLinesEx((Rectangle){(float)gridX * cellWidth, (float)gridY * cellHeight, (float)cellWidth, (float)cellHeight}, 3, Fade(highlightColor, 0.7f));
-                DrawCircleLines(gridX * cellWidth + cellWidth / 2, gridY * cellHeight + cellHeight / 2, g_towerStats[g_selectedBuildType][0].range, Fade(highlightColor, 0.5f));
+                DrawCircleLines(gridX * cellWidth + cellWidth / 2, gridY * cellHeight + cellHeight / 2, FxToFloat(g_towerStats[g_selectedBuildType][0].range), Fade(highlightColor, 0.5f));
             }
         }
         if (g_selectedTowerX != -1) {
             Tower* tower = &towers[g_selectedTowerX][g_selectedTowerY];
             TowerLevelStats stats = g_towerStats[tower->type][tower->level];
-            DrawCircleLines(g_selectedTowerX * cellWidth + cellWidth / 2, g_selectedTowerY * cellHeight + cellHeight / 2, stats.range, Fade(COLOR_NEON_WHITE, 0.8f));
+            DrawCircleLines(g_selectedTowerX * cellWidth + cellWidth / 2, g_selectedTowerY * cellHeight + cellHeight / 2, FxToFloat(stats.range), Fade(COLOR_NEON_WHITE, 0.8f));
         }
         
         DrawGameUI();
+        if (replayViewer.data) DrawReplayTimeline();
 
+        UpdateQualityGovernor((float)(GetTime() - frameStart), dt);
         EndDrawing();
     }
 
-    UnloadRenderTexture(backgroundTexture);
+    FinishReplayRecording();
+    FinishTelemetry();
+    StopAutosave();
+    CloseReplay(&replayViewer);
+    UnloadMinimap();
+    UnloadBackground();
+    UnloadPopupGlyphs();
+    UnloadEffectShader();
+    UnloadSpriteAtlas();
     UnloadGameAudio();
     CloseWindow();
     return 0;
 }
 
+// --- Sprite Atlas ---
+// Every tower, enemy and effect on the board is a quad from one atlas texture, so raylib
+// batches the whole board into a single draw call. resources/atlas.png is used when present;
+// otherwise the atlas is generated at startup by drawing the classic primitive shapes into it.
+// Layout, in cellWidth x cellHeight slots:
+//   row 0: tower bodies in TowerType order
+//   row 1: gun barrel, white disc, white ring, white pixel
+// White sprites are tinted when drawn.
+
+static void DrawTowerPlatform(float x, float y) {
+    DrawRectangle(x + 15, y + 15, cellWidth - 30, cellHeight - 30, DARKGRAY);
+    DrawRectangleLines(x + 15, y + 15, cellWidth - 30, cellHeight - 30, GRAY);
+}
+
+static Texture2D GenerateSpriteAtlas() {
+    RenderTexture2D target = LoadRenderTexture(SPRITE_ATLAS_COLUMNS * cellWidth, SPRITE_ATLAS_ROWS * cellHeight);
+    BeginTextureMode(target);
+        ClearBackground(BLANK);
+        for (int type = 0; type < TOWER_TYPE_COUNT; type++) {
+            float x = type * cellWidth;
+            Vector2 center = {x + cellWidth / 2.0f, cellHeight / 2.0f};
+            DrawTowerPlatform(x, 0);
+            switch (type) {
+                case TOWER_GUN:
+                    DrawCircleV(center, cellWidth/4.0f, (Color){80,80,90,255});
+                    DrawCircleLines(center.x, center.y, cellWidth/4.0f, (Color){120,120,130,255});
+                    break;
+                case TOWER_SLOW: // The aura pulses, so it is drawn by the effect shader
+                    break;
+                case TOWER_SPLASH:
+                    DrawRectangleV((Vector2){center.x - 18, center.y - 18}, (Vector2){36,36}, (Color){100,60,40,255});
+                    DrawCircleV(center, 12, DARKGRAY);
+                    DrawCircleV(center, 8, BLACK);
+                    break;
+                case TOWER_CHAIN:
+                    DrawCircleV(center, cellWidth/4.0f, (Color){60,40,90,255});
+                    DrawCircleLines(center.x, center.y, cellWidth/4.0f, COLOR_NEON_VIOLET);
+                    DrawCircleLines(center.x, center.y, cellWidth/6.0f, COLOR_NEON_VIOLET);
+                    break;
+            }
+        }
+        Rectangle barrel = g_spriteRects[SPRITE_GUN_BARREL];
+        DrawRectangleRec(barrel, COLOR_NEON_CYAN);
+        Rectangle disc = g_spriteRects[SPRITE_DISC];
+        DrawCircleV((Vector2){disc.x + disc.width / 2, disc.y + disc.height / 2}, disc.width / 2, WHITE);
+        Rectangle ring = g_spriteRects[SPRITE_RING];
+        DrawRing((Vector2){ring.x + ring.width / 2, ring.y + ring.height / 2}, ring.width / 2 - 2, ring.width / 2, 0, 360, 64, WHITE);
+        Rectangle pixel = g_spriteRects[SPRITE_PIXEL];
+        DrawRectangle(pixel.x - 1, pixel.y - 1, pixel.width + 2, pixel.height + 2, WHITE); // Margin keeps filtering from pulling in transparent texels
+    EndTextureMode();
+
+    Image image = LoadImageFromTexture(target.texture);
+    ImageFlipVertical(&image); // Render textures come back bottom-up
+    Texture2D atlas = LoadTextureFromImage(image);
+    UnloadImage(image);
+    UnloadRenderTexture(target);
+    return atlas;
+}
+
+void LoadSpriteAtlas() {
+    for (int type = 0; type < TOWER_TYPE_COUNT; type++) {
+        g_spriteRects[SPRITE_TOWER_BODY + type] = (Rectangle){type * cellWidth, 0, cellWidth, cellHeight};
+    }
+    float row = cellHeight;
+    g_spriteRects[SPRITE_GUN_BARREL] = (Rectangle){4, row + cellHeight / 2.0f - 4, cellWidth / 2.5f, 8};
+    g_spriteRects[SPRITE_DISC] = (Rectangle){cellWidth + 8, row + 8, cellWidth - 16, cellHeight - 16};
+    g_spriteRects[SPRITE_RING] = (Rectangle){2 * cellWidth + 8, row + 8, cellWidth - 16, cellHeight - 16};
+    g_spriteRects[SPRITE_PIXEL] = (Rectangle){3 * cellWidth + cellWidth / 2.0f - 1, row + cellHeight / 2.0f - 1, 2, 2};
+
+    g_spriteAtlas = FileExists(SPRITE_ATLAS_PATH) ? LoadTexture(SPRITE_ATLAS_PATH) : GenerateSpriteAtlas();
+    SetTextureFilter(g_spriteAtlas, TEXTURE_FILTER_BILINEAR); // Discs and rings are scaled to many radii
+}
+
+void UnloadSpriteAtlas() {
+    UnloadTexture(g_spriteAtlas);
+}
+
+static void DrawSprite(SpriteId id, Rectangle dest, Vector2 origin, float rotation, Color tint) {
+    DrawTexturePro(g_spriteAtlas, g_spriteRects[id], dest, origin, rotation, tint);
+}
+
+static void DrawSpriteDisc(Vector2 center, float radius, Color tint) {
+    DrawSprite(SPRITE_DISC, (Rectangle){center.x - radius, center.y - radius, 2 * radius, 2 * radius}, (Vector2){0, 0}, 0.0f, tint);
+}
+
+static void DrawSpriteRing(Vector2 center, float radius, Color tint) {
+    DrawSprite(SPRITE_RING, (Rectangle){center.x - radius, center.y - radius, 2 * radius, 2 * radius}, (Vector2){0, 0}, 0.0f, tint);
+}
+
+static void DrawSpriteRect(Rectangle rect, Color tint) {
+    DrawSprite(SPRITE_PIXEL, rect, (Vector2){0, 0}, 0.0f, tint);
+}
+
+static void DrawSpriteRectLines(Rectangle rect, float thickness, Color tint) {
+    DrawSpriteRect((Rectangle){rect.x, rect.y, rect.width, thickness}, tint);
+    DrawSpriteRect((Rectangle){rect.x, rect.y + rect.height - thickness, rect.width, thickness}, tint);
+    DrawSpriteRect((Rectangle){rect.x, rect.y + thickness, thickness, rect.height - 2 * thickness}, tint);
+    DrawSpriteRect((Rectangle){rect.x + rect.width - thickness, rect.y + thickness, thickness, rect.height - 2 * thickness}, tint);
+}
+
+static void DrawSpriteBeam(Vector2 from, Vector2 to, float thickness, Color tint) {
+    float angle = atan2f(to.y - from.y, to.x - from.x) * RAD2DEG;
+    DrawSprite(SPRITE_PIXEL, (Rectangle){from.x, from.y, Vector2Distance(from, to), thickness}, (Vector2){0, thickness / 2}, angle, tint);
+}
+
+// --- Effect Shader ---
+// The frost aura, muzzle flashes and explosions are animated in a fragment shader. The CPU only
+// queues one instance per effect (center, size, kind and a color whose alpha carries the
+// animation parameter); FlushEffects draws the queued ones as quads under the shader, which
+// evaluates the pulse from the time uniform and the shapes per pixel. Switching shaders ends the
+// sprite batch in progress, so each flush is its own draw call. There are three per frame, one
+// per layer: frost auras over the tower bodies, muzzle flashes over the barrels, and explosions
+// over the projectiles. GLSL 330 keeps it inside what Mesa's llvmpipe offers; if the shader
+// still fails to build, the same instances are drawn from the atlas sprites instead.
+//
+// Every quad samples raylib's 1x1 white texture, with the kind encoded in the texture
+// coordinates: kind k spans u in [2k, 2k+1] of a texture that claims to be
+// 2 * EFFECT_KIND_COUNT texels wide, and the gaps keep interpolation from crossing into the next kind.
+
+static const char *EFFECT_FRAGMENT_SHADER =
+    "#version 330\n"
+    "in vec2 fragTexCoord;\n"
+    "in vec4 fragColor;\n"
+    "out vec4 finalColor;\n"
+    "uniform float time;\n"
+    "uniform vec4 frostShape;\n" // Aura radius, core radius, pulse amplitude, quad half-size, in pixels
+    "uniform vec4 frostColor;\n"
+    "uniform vec4 coreColor;\n"
+    "vec4 Over(vec4 top, vec4 bottom) {\n"
+    "    float a = top.a + bottom.a * (1.0 - top.a);\n"
+    "    return vec4((top.rgb * top.a + bottom.rgb * bottom.a * (1.0 - top.a)) / max(a, 0.0001), a);\n"
+    "}\n"
+    "void main() {\n"
+    "    float slot = fragTexCoord.x * " EFFECT_SLOTS_GLSL ";\n"
+    "    float kind = floor((slot + 0.5) * 0.5);\n"
+    "    vec2 uv = vec2(slot - kind * 2.0, fragTexCoord.y) * 2.0 - 1.0;\n"
+    "    float d = length(uv);\n"
+    "    float aa = fwidth(d);\n"
+    "    if (kind < 0.5) {\n"
+    "        float px = d * frostShape.w;\n"
+    "        float pxAA = aa * frostShape.w;\n"
+    "        float radius = frostShape.x + sin(time * 5.0) * frostShape.z * fragColor.a;\n"
+    "        vec4 c = vec4(frostColor.rgb, frostColor.a * (1.0 - smoothstep(radius - pxAA, radius, px)));\n"
+    "        c = Over(vec4(coreColor.rgb, coreColor.a * (1.0 - smoothstep(frostShape.y - pxAA, frostShape.y, px))), c);\n"
+    "        c = Over(vec4(1.0, 1.0, 1.0, 0.8 * (1.0 - smoothstep(1.0 - pxAA, 1.0, abs(px - radius + 1.0)))), c);\n"
+    "        finalColor = c;\n"
+    "    } else if (kind < 1.5) {\n"
+    "        float disc = 1.0 - smoothstep(1.0 - aa, 1.0, d);\n"
+    "        finalColor = vec4(mix(vec3(1.0), fragColor.rgb, d), fragColor.a * disc);\n"
+    "    } else {\n"
+    "        float progress = fragColor.a;\n"
+    "        float blast = 1.0 - smoothstep(progress - aa, progress, d);\n"
+    "        finalColor = vec4(fragColor.rgb, clamp((1.0 - progress) * 1.2, 0.0, 1.0) * blast);\n"
+    "    }\n"
+    "}\n";
+
+void LoadEffectShader() {
+    g_effectShader = LoadShaderFromMemory(NULL, EFFECT_FRAGMENT_SHADER);
+    g_effectShaderReady = g_effectShader.id != 0 && g_effectShader.id != rlGetShaderIdDefault();
+    if (!g_effectShaderReady) {
+        TraceLog(LOG_WARNING, "Effect shader unavailable, drawing effects from sprites");
+        return;
+    }
+    g_effectTimeLoc = GetShaderLocation(g_effectShader, "time");
+    float frostShape[4] = {FROST_AURA_RADIUS, FROST_CORE_RADIUS, FROST_PULSE_AMPLITUDE, FROST_AURA_RADIUS + FROST_PULSE_AMPLITUDE + 1};
+    Vector4 frostColor = ColorNormalize(Fade(COLOR_FROST, 0.6f));
+    Vector4 coreColor = ColorNormalize(COLOR_NEON_CYAN);
+    SetShaderValue(g_effectShader, GetShaderLocation(g_effectShader, "frostShape"), frostShape, SHADER_UNIFORM_VEC4);
+    SetShaderValue(g_effectShader, GetShaderLocation(g_effectShader, "frostColor"), &frostColor, SHADER_UNIFORM_VEC4);
+    SetShaderValue(g_effectShader, GetShaderLocation(g_effectShader, "coreColor"), &coreColor, SHADER_UNIFORM_VEC4);
+}
+
+void UnloadEffectShader() {
+    if (g_effectShaderReady) UnloadShader(g_effectShader);
+    g_effectShaderReady = false;
+}
+
+static void QueueEffect(EffectKind kind, Vector2 center, float halfSize, Color data) {
+    if (g_effectCount >= MAX_EFFECTS) return;
+    g_effects[g_effectCount++] = (EffectInstance){center, halfSize, kind, data};
+}
+
+// Same effects from the atlas, for when the shader is unavailable
+static void DrawEffectSprites(const EffectInstance *effect) {
+    float param = effect->data.a / 255.0f;
+    switch (effect->kind) {
+        case EFFECT_FROST_AURA: {
+            float radius = FROST_AURA_RADIUS + sinf(g_renderTime * 5.0f) * FROST_PULSE_AMPLITUDE * param;
+            DrawSpriteDisc(effect->center, radius, Fade(COLOR_FROST, 0.6f));
+            DrawSpriteDisc(effect->center, FROST_CORE_RADIUS, COLOR_NEON_CYAN);
+            DrawSpriteRing(effect->center, radius, Fade(WHITE, 0.8f));
+            break;
+        }
+        case EFFECT_MUZZLE_FLASH:
+            DrawSpriteDisc(effect->center, effect->halfSize, effect->data);
+            break;
+        case EFFECT_EXPLOSION:
+            DrawSpriteDisc(effect->center, effect->halfSize * param, Fade(effect->data, (1.0f - param) * 1.2f));
+            break;
+        default: break;
+    }
+}
+
+// Draws and clears the queued effects
+void FlushEffects() {
+    if (!g_effectShaderReady) {
+        for (int i = 0; i < g_effectCount; i++) DrawEffectSprites(&g_effects[i]);
+        g_effectCount = 0;
+        return;
+    }
+    Texture2D slots = {rlGetTextureIdDefault(), EFFECT_SLOTS, 1, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+    float time = (float)fmod(g_renderTime, 2.0 * PI / 5.0); // One pulse period, so float precision holds up in long sessions
+    BeginShaderMode(g_effectShader);
+        SetShaderValue(g_effectShader, g_effectTimeLoc, &time, SHADER_UNIFORM_FLOAT);
+        for (int i = 0; i < g_effectCount; i++) {
+            const EffectInstance *effect = &g_effects[i];
+            Rectangle source = {2.0f * effect->kind, 0, 1, 1};
+            Rectangle dest = {effect->center.x - effect->halfSize, effect->center.y - effect->halfSize, 2 * effect->halfSize, 2 * effect->halfSize};
+            DrawTexturePro(slots, source, dest, (Vector2){0, 0}, 0.0f, effect->data);
+        }
+    EndShaderMode();
+    g_effectCount = 0;
+}
+
+// --- Background Chunks ---
+// The grid, path and walls are split into BACKGROUND_CHUNK_CELLS-square chunks, each cached in
+// its own render texture. A chunk is rendered the first time it intersects the view and again
+// only when the wall or path-link bits of its cells differ from the ones it was rendered from.
+// When the resident textures would exceed BACKGROUND_CHUNK_BUDGET, the off-view chunk farthest
+// from the view center is evicted first. UpdateBackground renders and must run outside any
+// BeginTextureMode; DrawBackground only draws.
+
+static Rectangle GetBackgroundChunkRect(int cx, int cy) {
+    float x = cx * BACKGROUND_CHUNK_CELLS * cellWidth;
+    float y = cy * BACKGROUND_CHUNK_CELLS * cellHeight;
+    return (Rectangle){x, y, fminf(BACKGROUND_CHUNK_CELLS * cellWidth, GRID_SIZE * cellWidth - x), fminf(BACKGROUND_CHUNK_CELLS * cellHeight, GRID_SIZE * cellHeight - y)};
+}
+
+static size_t GetBackgroundChunkBytes(int cx, int cy) {
+    Rectangle rect = GetBackgroundChunkRect(cx, cy);
+    return (size_t)rect.width * (size_t)rect.height * 4;
+}
+
+static unsigned char GetBackgroundCellBits(int x, int y) {
+    return (walls[x][y] ? CELL_WALL : 0) | g_pathLinks[x][y];
+}
+
+static bool IsBackgroundChunkStale(const BackgroundChunk *chunk, int cx, int cy) {
+    for (int i = 0; i < BACKGROUND_CHUNK_CELLS; i++) {
+        for (int j = 0; j < BACKGROUND_CHUNK_CELLS; j++) {
+            int x = cx * BACKGROUND_CHUNK_CELLS + i, y = cy * BACKGROUND_CHUNK_CELLS + j;
+            if (x < GRID_SIZE && y < GRID_SIZE && chunk->cells[i][j] != GetBackgroundCellBits(x, y)) return true;
+        }
+    }
+    return false;
+}
+
+static void RenderBackgroundChunk(BackgroundChunk *chunk, int cx, int cy) {
+    Rectangle rect = GetBackgroundChunkRect(cx, cy);
+    int x0 = cx * BACKGROUND_CHUNK_CELLS, y0 = cy * BACKGROUND_CHUNK_CELLS;
+    int x1 = x0 + (int)rect.width / cellWidth, y1 = y0 + (int)rect.height / cellHeight; // Exclusive
+    BeginTextureMode(chunk->texture);
+    BeginMode2D((Camera2D){.target = {rect.x, rect.y}, .zoom = 1.0f});
+        ClearBackground(COLOR_BLACK);
+        for (int y = y0; y <= y1; y++) DrawLine(rect.x, y * cellHeight, rect.x + rect.width, y * cellHeight, COLOR_BG_GRID);
+        for (int x = x0; x <= x1; x++) DrawLine(x * cellWidth, rect.y, x * cellWidth, rect.y + rect.height, COLOR_BG_GRID);
+        for (int x = x0; x < x1; x++) {
+            for (int y = y0; y < y1; y++) {
+                unsigned char bits = GetBackgroundCellBits(x, y);
+                chunk->cells[x - x0][y - y0] = bits;
+                // Each link is drawn from both of its cells, so a segment crossing a chunk edge appears in both chunks
+                Vector2 center = {x * cellWidth + cellWidth/2, y * cellHeight + cellHeight/2};
+                if (bits & CELL_LINK_UP) DrawLineEx(center, (Vector2){center.x, center.y - cellHeight}, 10, COLOR_PATH);
+                if (bits & CELL_LINK_DOWN) DrawLineEx(center, (Vector2){center.x, center.y + cellHeight}, 10, COLOR_PATH);
+                if (bits & CELL_LINK_LEFT) DrawLineEx(center, (Vector2){center.x - cellWidth, center.y}, 10, COLOR_PATH);
+                if (bits & CELL_LINK_RIGHT) DrawLineEx(center, (Vector2){center.x + cellWidth, center.y}, 10, COLOR_PATH);
+                if (bits & CELL_WALL) DrawWall(x, y);
+            }
+        }
+    EndMode2D();
+    EndTextureMode();
+}
+
+static void EvictBackgroundChunks(Rectangle view, size_t incoming) {
+    Vector2 viewCenter = {view.x + view.width / 2, view.y + view.height / 2};
+    while (g_backgroundBytes + incoming > BACKGROUND_CHUNK_BUDGET) {
+        int victimX = -1, victimY = -1;
+        float farthest = -1.0f;
+        for (int cx = 0; cx < BACKGROUND_CHUNKS; cx++) {
+            for (int cy = 0; cy < BACKGROUND_CHUNKS; cy++) {
+                Rectangle rect = GetBackgroundChunkRect(cx, cy);
+                if (!g_backgroundChunks[cx][cy].loaded || CheckCollisionRecs(rect, view)) continue;
+                float distance = Vector2DistanceSqr(viewCenter, (Vector2){rect.x + rect.width / 2, rect.y + rect.height / 2});
+                if (distance > farthest) {
+                    farthest = distance;
+                    victimX = cx;
+                    victimY = cy;
+                }
+            }
+        }
+        if (victimX == -1) return; // Everything resident is on screen, so go over budget rather than drop visible chunks
+        UnloadRenderTexture(g_backgroundChunks[victimX][victimY].texture);
+        g_backgroundChunks[victimX][victimY].loaded = false;
+        g_backgroundBytes -= GetBackgroundChunkBytes(victimX, victimY);
+    }
+}
+
+void UpdateBackground(Rectangle view) {
+    for (int cx = 0; cx < BACKGROUND_CHUNKS; cx++) {
+        for (int cy = 0; cy < BACKGROUND_CHUNKS; cy++) {
+            Rectangle rect = GetBackgroundChunkRect(cx, cy);
+            if (!CheckCollisionRecs(rect, view)) continue;
+            BackgroundChunk *chunk = &g_backgroundChunks[cx][cy];
+            if (!chunk->loaded) {
+                EvictBackgroundChunks(view, GetBackgroundChunkBytes(cx, cy));
+                chunk->texture = LoadRenderTexture((int)rect.width, (int)rect.height);
+                chunk->loaded = true;
+                g_backgroundBytes += GetBackgroundChunkBytes(cx, cy);
+                RenderBackgroundChunk(chunk, cx, cy);
+            } else if (IsBackgroundChunkStale(chunk, cx, cy)) {
+                RenderBackgroundChunk(chunk, cx, cy);
+            }
+        }
+    }
+}
+
+void DrawBackground(Rectangle view) {
+    for (int cx = 0; cx < BACKGROUND_CHUNKS; cx++) {
+        for (int cy = 0; cy < BACKGROUND_CHUNKS; cy++) {
+            Rectangle rect = GetBackgroundChunkRect(cx, cy);
+            const BackgroundChunk *chunk = &g_backgroundChunks[cx][cy];
+            if (!chunk->loaded || !CheckCollisionRecs(rect, view)) continue;
+            DrawTextureRec(chunk->texture.texture, (Rectangle){0, 0, rect.width, -rect.height}, (Vector2){rect.x, rect.y}, WHITE);
+        }
+    }
+}
+
+void UnloadBackground() {
+    for (int cx = 0; cx < BACKGROUND_CHUNKS; cx++) {
+        for (int cy = 0; cy < BACKGROUND_CHUNKS; cy++) {
+            if (g_backgroundChunks[cx][cy].loaded) UnloadRenderTexture(g_backgroundChunks[cx][cy].texture);
+            g_backgroundChunks[cx][cy].loaded = false;
+        }
+    }
+    g_backgroundBytes = 0;
+}
+
+// --- Minimap ---
+// The path, walls and towers are drawn once into a MINIMAP_SIZE texture and redrawn only when
+// a cell's wall, path or tower bits change. Enemies are not drawn one by one: each frame they
+// are counted into a histogram over path distance, and every occupied bin becomes one splat at
+// its point on the path, sized and faded in by its count. That is one pass of integer adds over
+// the wave plus at most one quad per bin, whatever the enemy count.
+
+static unsigned char GetMinimapCellBits(int x, int y) {
+    unsigned char bits = GetBackgroundCellBits(x, y);
+    if (towers[x][y].active) bits |= (towers[x][y].type + 1) << 5;
+    return bits;
+}
+
+static void RenderMinimap() {
+    static const Color towerColors[TOWER_TYPE_COUNT] = {COLOR_NEON_CYAN, COLOR_FROST, COLOR_NEON_ORANGE, COLOR_NEON_VIOLET};
+    BeginTextureMode(g_minimap.texture);
+    BeginMode2D((Camera2D){.zoom = (float)MINIMAP_SIZE / (GRID_SIZE * cellWidth)});
+        ClearBackground(COLOR_BLACK);
+        for (int x = 0; x < GRID_SIZE; x++) {
+            for (int y = 0; y < GRID_SIZE; y++) {
+                unsigned char bits = GetMinimapCellBits(x, y);
+                g_minimap.cells[x][y] = bits;
+                Vector2 center = {x * cellWidth + cellWidth/2, y * cellHeight + cellHeight/2};
+                if (bits & CELL_LINK_DOWN) DrawLineEx(center, (Vector2){center.x, center.y + cellHeight}, 24, COLOR_PATH);
+                if (bits & CELL_LINK_RIGHT) DrawLineEx(center, (Vector2){center.x + cellWidth, center.y}, 24, COLOR_PATH);
+                if (bits & CELL_WALL) DrawWall(x, y);
+                if (towers[x][y].active) DrawRectangle(x * cellWidth + 15, y * cellHeight + 15, cellWidth - 30, cellHeight - 30, towerColors[towers[x][y].type]);
+            }
+        }
+    EndMode2D();
+    EndTextureMode();
+}
+
+// Must run outside any BeginTextureMode, like UpdateBackground
+void UpdateMinimap() {
+    if (!g_minimap.loaded) {
+        g_minimap.texture = LoadRenderTexture(MINIMAP_SIZE, MINIMAP_SIZE);
+        g_minimap.loaded = true;
+        RenderMinimap();
+        return;
+    }
+    for (int x = 0; x < GRID_SIZE; x++) {
+        for (int y = 0; y < GRID_SIZE; y++) {
+            if (g_minimap.cells[x][y] != GetMinimapCellBits(x, y)) {
+                RenderMinimap();
+                return;
+            }
+        }
+    }
+}
+
+void DrawMinimap(Rectangle bounds) {
+    if (!g_minimap.loaded) return;
+    DrawTexturePro(g_minimap.texture.texture, (Rectangle){0, 0, MINIMAP_SIZE, -MINIMAP_SIZE}, bounds, (Vector2){0, 0}, 0.0f, WHITE);
+
+    float scale = bounds.width / (GRID_SIZE * cellWidth);
+    int bins = (pathLength - 1) * MINIMAP_BINS_PER_NODE;
+    if (bins > 0) {
+        memset(g_minimapHistogram, 0, bins * sizeof(int));
+        for (int i = 0; i < activeWave.enemyCount; i++) {
+            const Enemy *enemy = &activeWave.enemies[i];
+            if (!enemy->active) continue;
+            int bin = (int)(((int64_t)enemy->progress * MINIMAP_BINS_PER_NODE) >> FX_SHIFT);
+            g_minimapHistogram[bin < 0 ? 0 : bin < bins ? bin : bins - 1]++;
+        }
+        for (int bin = 0; bin < bins; bin++) {
+            int count = g_minimapHistogram[bin];
+            if (count == 0) continue;
+            int node = bin / MINIMAP_BINS_PER_NODE;
+            float t = (bin % MINIMAP_BINS_PER_NODE + 0.5f) / MINIMAP_BINS_PER_NODE;
+            Vector2 pos = Vector2Lerp(FxToVector2(pathPoints[node]), FxToVector2(pathPoints[node + 1]), t);
+            Vector2 splat = {bounds.x + pos.x * scale, bounds.y + pos.y * scale};
+            DrawSpriteDisc(splat, 1.5f + sqrtf((float)count), Fade(COLOR_NEON_RED, fminf(1.0f, 0.35f + 0.15f * count)));
+        }
+    }
+    DrawRectangleLinesEx((Rectangle){bounds.x + g_cameraView.x * scale, bounds.y + g_cameraView.y * scale, g_cameraView.width * scale, g_cameraView.height * scale}, 1, Fade(COLOR_NEON_WHITE, 0.5f));
+    DrawRectangleLinesEx(bounds, 1, COLOR_UI_ACCENT);
+}
+
+void UnloadMinimap() {
+    if (g_minimap.loaded) UnloadRenderTexture(g_minimap.texture);
+    g_minimap.loaded = false;
+}
+
+// --- Popups ---
+// Floating damage and gold numbers. The sim reports hits and kills like it fires projectiles;
+// the popups live in a fixed pool that drops new ones when full. A hit on an enemy whose damage
+// popup is still fresh adds to it instead of taking a slot. All text is drawn as quads from a
+// small white glyph atlas of the digits, '+' and '$', rendered once from the default font, so
+// every popup on screen goes out in one batch with no per-popup string formatting.
+
+void LoadPopupGlyphs() {
+    RenderTexture2D target = LoadRenderTexture(POPUP_GLYPH_COUNT * POPUP_GLYPH_WIDTH, POPUP_GLYPH_HEIGHT);
+    BeginTextureMode(target);
+        ClearBackground(BLANK);
+        for (int i = 0; i < POPUP_GLYPH_COUNT; i++) {
+            char glyph[2] = {POPUP_GLYPHS[i], '\0'};
+            g_glyphAdvance[i] = MeasureText(glyph, POPUP_GLYPH_HEIGHT);
+            DrawText(glyph, i * POPUP_GLYPH_WIDTH + (POPUP_GLYPH_WIDTH - g_glyphAdvance[i]) / 2, 0, POPUP_GLYPH_HEIGHT, WHITE);
+        }
+    EndTextureMode();
+
+    Image image = LoadImageFromTexture(target.texture);
+    ImageFlipVertical(&image);
+    g_glyphAtlas = LoadTextureFromImage(image);
+    SetTextureFilter(g_glyphAtlas, TEXTURE_FILTER_BILINEAR);
+    UnloadImage(image);
+    UnloadRenderTexture(target);
+}
+
+void UnloadPopupGlyphs() {
+    UnloadTexture(g_glyphAtlas);
+}
+
+static Popup *AddPopup(PopupKind kind, int enemyIndex, FxVec2 pos, fixed_t value) {
+    if (g_popupCount >= MAX_POPUPS) return NULL;
+    Popup *popup = &g_popups[g_popupCount++];
+    *popup = (Popup){kind, enemyIndex, value, FxToVector2(pos), 0.0f};
+    return popup;
+}
+
+void ShowDamagePopup(int enemyIndex, FxVec2 pos, fixed_t damage) {
+    int slot = g_popupByEnemy[enemyIndex];
+    if (slot < g_popupCount && g_popups[slot].kind == POPUP_DAMAGE && g_popups[slot].enemyIndex == enemyIndex && g_popups[slot].age < POPUP_MERGE_WINDOW) {
+        g_popups[slot].value += damage;
+        g_popups[slot].pos = FxToVector2(pos);
+        g_popups[slot].age = 0.0f;
+        return;
+    }
+    if (AddPopup(POPUP_DAMAGE, enemyIndex, pos, damage)) g_popupByEnemy[enemyIndex] = g_popupCount - 1;
+}
+
+void ShowGoldPopup(FxVec2 pos, int money) {
+    AddPopup(POPUP_GOLD, -1, pos, FX_INT(money));
+}
+
+// Quads for one popup's text, centered on pos
+static void DrawPopupText(const char *text, Vector2 pos, float scale, Color tint) {
+    int glyphs[16], count = 0;
+    float width = 0;
+    for (const char *c = text; *c && count < 16; c++) {
+        int g = (int)(strchr(POPUP_GLYPHS, *c) - POPUP_GLYPHS);
+        glyphs[count++] = g;
+        width += (g_glyphAdvance[g] + 2) * scale;
+    }
+    float x = pos.x - width / 2;
+    for (int i = 0; i < count; i++) {
+        int g = glyphs[i];
+        float inset = (POPUP_GLYPH_WIDTH - g_glyphAdvance[g]) / 2.0f;
+        Rectangle source = {g * POPUP_GLYPH_WIDTH + inset, 0, g_glyphAdvance[g], POPUP_GLYPH_HEIGHT};
+        DrawTexturePro(g_glyphAtlas, source, (Rectangle){x, pos.y - POPUP_GLYPH_HEIGHT * scale / 2, g_glyphAdvance[g] * scale, POPUP_GLYPH_HEIGHT * scale}, (Vector2){0, 0}, 0.0f, tint);
+        x += (g_glyphAdvance[g] + 2) * scale;
+    }
+}
+
+void UpdateAndDrawPopups(float dt) {
+    for (int i = 0; i < g_popupCount; i++) {
+        Popup *popup = &g_popups[i];
+        popup->age += dt;
+        if (popup->age >= POPUP_LIFETIME) {
+            *popup = g_popups[--g_popupCount];
+            if (popup->kind == POPUP_DAMAGE) g_popupByEnemy[popup->enemyIndex] = i;
+            i--;
+            continue;
+        }
+
+        // Digits written back to front, so no formatting call per popup
+        char text[16];
+        int n = (int)((popup->value + FX_ONE / 2) >> FX_SHIFT);
+        char *end = text + sizeof(text) - 1, *c = end;
+        *c = '\0';
+        do { *--c = (char)('0' + n % 10); n /= 10; } while (n > 0);
+        if (popup->kind == POPUP_GOLD) { *--c = '$'; *--c = '+'; }
+
+        float t = popup->age / POPUP_LIFETIME;
+        float pop = 1.0f + 0.4f * fmaxf(0.0f, 1.0f - popup->age / 0.1f); // Brief swell when spawned or hit again
+        float scale = (popup->kind == POPUP_GOLD ? 0.8f : 0.6f) * pop;
+        Color color = popup->kind == POPUP_GOLD ? GOLD : COLOR_NEON_WHITE;
+        Vector2 pos = {popup->pos.x, popup->pos.y - 18 - 30 * t};
+        DrawPopupText(c, pos, scale, Fade(color, t < 0.6f ? 1.0f : (1.0f - t) / 0.4f));
+    }
+}
+
 // --- Drawing & UI Functions ---
 
+// Everything below the UI: background, enemies, towers and projectile effects
+void DrawGameScene(float projectileDt) {
+    ClearBackground(COLOR_BLACK);
+    DrawBackground(g_cameraView);
+    DrawEnemies(&activeWave);
+    DrawTowers();
+    DrawShots();
+    UpdateAndDrawProjectiles(projectileDt);
+    FlushEffects(); // Explosions
+    UpdateAndDrawPopups(projectileDt);
+}
+
+// Frame cost is the CPU time spent updating and drawing, or the whole frame once frames are
+// being missed (GPU bound). The governor steps quality down one level at a time while the cost
+// stays high, and back up only after a longer stretch of headroom, so it does not oscillate.
+void UpdateQualityGovernor(float workSeconds, float frameSeconds) {
+    float cost = workSeconds;
+    if (frameSeconds > QUALITY_FRAME_BUDGET * 1.25f && frameSeconds > cost) cost = frameSeconds;
+    g_frameLoad += (cost / QUALITY_FRAME_BUDGET - g_frameLoad) * 0.1f;
+
+    if (g_frameLoad > QUALITY_DEGRADE_LOAD && g_qualityLevel < QUALITY_LEVEL_COUNT - 1) {
+        g_qualityStreak = g_qualityStreak > 0 ? g_qualityStreak + 1 : 1;
+        if (g_qualityStreak >= QUALITY_DEGRADE_FRAMES) {
+            g_qualityLevel++;
+            g_qualityStreak = 0;
+        }
+    } else if (g_frameLoad < QUALITY_RESTORE_LOAD && g_qualityLevel > QUALITY_FULL) {
+        g_qualityStreak = g_qualityStreak < 0 ? g_qualityStreak - 1 : -1;
+        if (-g_qualityStreak >= QUALITY_RESTORE_FRAMES) {
+            g_qualityLevel--;
+            g_qualityStreak = 0;
+        }
+    } else {
+        g_qualityStreak = 0;
+    }
+}
+
+// Rounds in flight, placed by how many of their ticks have elapsed
+void DrawShots() {
+    for (int i = 0; i < activeWave.shotCount; i++) {
+        const Shot *shot = &activeWave.shots[i];
+        Vector2 from = FxToVector2(shot->from), to = FxToVector2(shot->to);
+        float t = 1.0f - (float)shot->ticksLeft / shot->flightTicks;
+        Vector2 pos = Vector2Lerp(from, to, t);
+        if (shot->towerType == TOWER_GUN) {
+            DrawSpriteBeam(Vector2Lerp(from, to, fmaxf(0.0f, t - 0.2f)), pos, 2, Fade(COLOR_NEON_WHITE, 0.6f));
+            DrawSpriteDisc(pos, 3, WHITE);
+        } else {
+            DrawSpriteDisc(pos, 6, COLOR_NEON_ORANGE);
+            DrawSpriteDisc(pos, 3, DARKGRAY);
+        }
+    }
+}
+
 void UpdateAndDrawProjectiles(float dt) {
+    bool mergeBeams = g_qualityLevel >= QUALITY_MERGED_BEAMS;
     for (int i = 0; i < projectileCount; i++) {
         projectiles[i].lifeTimer -= dt;
         if (projectiles[i].lifeTimer > 0) {
             if (projectiles[i].isSplash) {
-                // Draw an expanding circle for the explosion
-                DrawCircleV(projectiles[i].endPos, projectiles[i].splashRadius * (1.0f - (projectiles[i].lifeTimer / 0.15f)), Fade(projectiles[i].color, projectiles[i].lifeTimer * 8.0f));
-            } else {
-                DrawLineEx(projectiles[i].startPos, projectiles[i].endPos, 3, Fade(projectiles[i].color, projectiles[i].lifeTimer * 10));
+                // The explosion expands and fades in the effect shader
+                Color data = projectiles[i].color;
+                data.a = (unsigned char)((1.0f - projectiles[i].lifeTimer / 0.15f) * 255.0f);
+                QueueEffect(EFFECT_EXPLOSION, projectiles[i].endPos, projectiles[i].splashRadius, data);
+            } else if (!mergeBeams) {
+                DrawSpriteBeam(projectiles[i].startPos, projectiles[i].endPos, 3, Fade(projectiles[i].color, projectiles[i].lifeTimer * 10));
             }
         } else {
             projectiles[i] = projectiles[projectileCount - 1];
@@ -673,9 +4985,32 @@ void UpdateAndDrawProjectiles(float dt) {
             i--;
         }
     }
+    // Merged beams are hairlines drawn together in one pass after the explosions
+    if (mergeBeams) {
+        for (int i = 0; i < projectileCount; i++) {
+            if (!projectiles[i].isSplash) DrawSpriteBeam(projectiles[i].startPos, projectiles[i].endPos, 1, Fade(projectiles[i].color, projectiles[i].lifeTimer * 10));
+        }
+    }
 }
 
 void DrawTowers() {
+    Vector2 focus = g_selectedTowerX != -1 ? (Vector2){g_selectedTowerX * cellWidth + cellWidth / 2.0f, g_selectedTowerY * cellHeight + cellHeight / 2.0f}
+                                           : GetMousePosition();
+    // Bodies first, with the frost auras flushed over them, so barrels, orbs and level pips stay on top
+    for (int x = 0; x < GRID_SIZE; x++) {
+        for (int y = 0; y < GRID_SIZE; y++) {
+            Tower *tower = &towers[x][y];
+            if (!tower->active) continue;
+            DrawSprite(SPRITE_TOWER_BODY + tower->type, (Rectangle){x * cellWidth, y * cellHeight, cellWidth, cellHeight}, (Vector2){0, 0}, 0.0f, WHITE);
+            if (tower->type == TOWER_SLOW) {
+                Vector2 center = {x * cellWidth + cellWidth / 2.0f, y * cellHeight + cellHeight / 2.0f};
+                unsigned char pulse = g_qualityLevel >= QUALITY_STATIC_FROST ? 0 : 255;
+                QueueEffect(EFFECT_FROST_AURA, center, FROST_AURA_RADIUS + FROST_PULSE_AMPLITUDE + 1, (Color){255, 255, 255, pulse});
+            }
+        }
+    }
+    FlushEffects();
+
     for (int x = 0; x < GRID_SIZE; x++) {
         for (int y = 0; y < GRID_SIZE; y++) {
             if (towers[x][y].active) {
@@ -683,51 +5018,44 @@ void DrawTowers() {
                 float screenX = x * cellWidth;
                 float screenY = y * cellHeight;
                 Vector2 center = {screenX + cellWidth/2.0f, screenY + cellHeight/2.0f};
-                
-                // Base platform
-                DrawRectangle(screenX + 15, screenY + 15, cellWidth - 30, cellHeight - 30, DARKGRAY);
-                DrawRectangleLines(screenX + 15, screenY + 15, cellWidth - 30, cellHeight - 30, GRAY);
-
 
                 switch(tower->type) {
                     case TOWER_GUN: {
-                        // Turret Base
-                        DrawCircleV(center, cellWidth/4.0f, (Color){80,80,90,255});
-                        DrawCircleLines(center.x, center.y, cellWidth/4.0f, (Color){120,120,130,255});
+                        // Aim at the current target, easing along the shortest arc
+                        if (tower->targetIndex != -1 && activeWave.enemies[tower->targetIndex].active) {
+                            Vector2 targetPos = FxToVector2(GetEnemyPos(tower->targetIndex));
+                            float desired = atan2f(targetPos.y - center.y, targetPos.x - center.x) * RAD2DEG;
+                            float delta = fmodf(desired - g_towerRotation[x][y] + 540.0f, 360.0f) - 180.0f;
+                            g_towerRotation[x][y] += delta * (1.0f - expf(-TURRET_TURN_RATE * g_renderDt));
+                        }
+                        float rotation = g_towerRotation[x][y];
                         // Turret Barrel
-                        Rectangle barrel = {center.x, center.y - 4, cellWidth/2.5f, 8};
-                        DrawRectanglePro(barrel, (Vector2){0, 4}, tower->rotation, COLOR_NEON_CYAN);
+                        Rectangle barrel = {center.x, center.y, cellWidth/2.5f, 8};
+                        DrawSprite(SPRITE_GUN_BARREL, barrel, (Vector2){0, 4}, rotation, WHITE);
                         // Muzzle Flash
                         if (tower->muzzleFlashTimer > 0) {
-                            float angleRad = tower->rotation * DEG2RAD;
+                            float angleRad = rotation * DEG2RAD;
                             Vector2 flashPos = {center.x + cosf(angleRad) * (cellWidth/2.5f), center.y + sinf(angleRad) * (cellWidth/2.5f)};
-                            DrawCircleV(flashPos, 8, Fade(YELLOW, tower->muzzleFlashTimer * 10.0f));
+                            QueueEffect(EFFECT_MUZZLE_FLASH, flashPos, 8, Fade(YELLOW, FxToFloat(tower->muzzleFlashTimer) * 10.0f));
                         }
                         break;
                     }
-                    case TOWER_SLOW: {
-                        float pulse = sinf(GetTime() * 5.0f) * 3.0f;
-                        DrawCircleV(center, cellWidth/3.0f + pulse, Fade(COLOR_FROST, 0.6f));
-                        DrawCircleV(center, cellWidth/4.5f, COLOR_NEON_CYAN);
-                        DrawCircleLines(center.x, center.y, cellWidth/3.0f + pulse, Fade(WHITE, 0.8f));
-                        break;
-                    }
-                    case TOWER_SPLASH: {
-                        // Cannon Base
-                        DrawRectangleV((Vector2){center.x - 18, center.y - 18}, (Vector2){36,36}, (Color){100,60,40,255});
-                        // Cannon Barrel
-                        DrawCircleV(center, 12, DARKGRAY);
-                        DrawCircleV(center, 8, BLACK);
+                    case TOWER_CHAIN: {
+                        // Charged Orb
+                        DrawSpriteDisc(center, 6, (tower->muzzleFlashTimer > 0) ? WHITE : COLOR_NEON_VIOLET);
                         break;
                     }
+                    default: break;
                 }
                 // Draw level indicator
-                for (int i = 0; i <= tower->level; i++) {
-                    DrawCircle(screenX + 10 + i*6, screenY + cellHeight - 10, 3, GOLD);
+                bool showPips = g_qualityLevel < QUALITY_NEAR_PIPS_ONLY || Vector2Distance(center, focus) < QUALITY_PIP_RADIUS;
+                for (int i = 0; showPips && i <= tower->level; i++) {
+                    DrawSpriteDisc((Vector2){screenX + 10 + i*6, screenY + cellHeight - 10}, 3, GOLD);
                 }
             }
         }
     }
+    FlushEffects(); // Muzzle flashes
 }
 
 void DrawWall(int cellX, int cellY) {
@@ -737,22 +5065,29 @@ void DrawWall(int cellX, int cellY) {
 }
 
 void DrawEnemies(const EnemyWave *wave) {
+    // Off-screen enemies are skipped by their path segment, before their position is built
+    Rectangle view = {g_cameraView.x - cellWidth, g_cameraView.y - cellHeight, g_cameraView.width + 2 * cellWidth, g_cameraView.height + 2 * cellHeight};
     for (int i = 0; i < wave->enemyCount; i++) {
         const Enemy *enemy = &wave->enemies[i];
         if (enemy->active) {
+            int next = enemy->pathIndex < pathLength - 1 ? enemy->pathIndex + 1 : enemy->pathIndex;
+            if (!CheckCollisionPointRec(FxToVector2(pathPoints[enemy->pathIndex]), view) &&
+                !CheckCollisionPointRec(FxToVector2(pathPoints[next]), view)) continue;
+            Vector2 pos = FxToVector2(GetEnemyPos(i));
             Color color = enemyTypes[enemy->type].color;
             if (enemy->slowTimer > 0) color = ColorBrightness(color, -0.4f);
             
-            DrawCircleV(enemy->pos, enemyTypes[enemy->type].radius, color);
-            if (enemy->slowTimer > 0) DrawCircleLines(enemy->pos.x, enemy->pos.y, enemyTypes[enemy->type].radius + 2, COLOR_FROST);
+            DrawSpriteDisc(pos, enemyTypes[enemy->type].radius, color);
+            if (enemy->slowTimer > 0) DrawSpriteRing(pos, enemyTypes[enemy->type].radius + 2, COLOR_FROST);
 
-            float healthPercentage = enemy->health / enemy->maxHealth;
+            if (g_qualityLevel >= QUALITY_NO_FULL_HEALTH_BARS && enemy->health >= enemy->maxHealth) continue;
+            float healthPercentage = FxToFloat(enemy->health) / FxToFloat(enemy->maxHealth);
             float barWidth = cellWidth * 0.8f;
             float barHeight = 8.0f;
-            Vector2 barPos = {enemy->pos.x - barWidth / 2, enemy->pos.y - cellHeight / 2.0f - barHeight};
-            DrawRectangleV(barPos, (Vector2){barWidth, barHeight}, Fade(BLACK, 0.7f));
-            DrawRectangleV(barPos, (Vector2){barWidth * healthPercentage, barHeight}, COLOR_HEALTH_GREEN);
-            DrawRectangleLinesEx((Rectangle){barPos.x, barPos.y, barWidth, barHeight}, 1, Fade(COLOR_NEON_CYAN, 0.8f));
+            Vector2 barPos = {pos.x - barWidth / 2, pos.y - cellHeight / 2.0f - barHeight};
+            DrawSpriteRect((Rectangle){barPos.x, barPos.y, barWidth, barHeight}, Fade(BLACK, 0.7f));
+            DrawSpriteRect((Rectangle){barPos.x, barPos.y, barWidth * healthPercentage, barHeight}, COLOR_HEALTH_GREEN);
+            DrawSpriteRectLines((Rectangle){barPos.x, barPos.y, barWidth, barHeight}, 1, Fade(COLOR_NEON_CYAN, 0.8f));
         }
     }
 }
@@ -769,30 +5104,26 @@ void DrawGameUI() {
     DrawText(TextFormat("MONEY: $%d", playerMoney), uiX, 80, 20, COLOR_NEON_ORANGE);
     DrawText(TextFormat("SPEED: %.0fx", gameSpeed), uiX, 110, 20, COLOR_NEON_WHITE);
     DrawText("F: Toggle Speed | P: Pause", uiX, 135, 10, GRAY);
+    if (g_qualityLevel > QUALITY_FULL) DrawText(TextFormat("Reduced effects: %d", g_qualityLevel), uiX, 147, 10, GRAY);
     
     // UI Separator
     DrawLine(GAME_AREA_WIDTH, 160, SCREEN_WIDTH, 160, COLOR_UI_ACCENT);
 
+    UiLayout layout;
+    LayoutGameUI(&layout);
     if (g_selectedTowerX != -1) {
-        DrawSelectionUI();
+        DrawSelectionUI(&layout);
     } else {
-        DrawBuildUI();
+        DrawBuildUI(&layout);
     }
+    DrawMinimap((Rectangle){GAME_AREA_WIDTH + (SCREEN_WIDTH - GAME_AREA_WIDTH - MINIMAP_SIZE) / 2, MINIMAP_Y, MINIMAP_SIZE, MINIMAP_SIZE});
     
     // Game State Information
     if (gameState == GAME_STATE_WAVE_TRANSITION) {
-        int btnY = SCREEN_HEIGHT - 70;
-        Rectangle startButton = {GAME_AREA_WIDTH + 15, btnY, 170, 50};
-        bool hovered = CheckCollisionPointRec(GetMousePosition(), startButton);
-        DrawRectangleRec(startButton, hovered ? COLOR_UI_ACCENT : COLOR_NEON_CYAN);
+        Rectangle startButton = FindUIElement(&layout, UI_START_WAVE, 0)->bounds;
+        DrawRectangleRec(startButton, IsUIElementHovered(UI_START_WAVE, 0) ? COLOR_UI_ACCENT : COLOR_NEON_CYAN);
         const char* text = TextFormat("START WAVE %d", currentWaveNumber + 1);
         DrawText(text, startButton.x + startButton.width/2 - MeasureText(text, 20)/2, startButton.y + 15, 20, COLOR_BLACK);
-        
-        if (hovered && IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
-            currentWaveNumber++;
-            CreateWave(currentWaveNumber);
-            gameState = GAME_STATE_PLAYING;
-        }
     } else if (gameState == GAME_STATE_GAME_OVER) {
         DrawRectangle(0, 0, GAME_AREA_WIDTH, SCREEN_HEIGHT, Fade(BLACK, 0.7f));
         DrawText("GAME OVER", GAME_AREA_WIDTH / 2 - MeasureText("GAME OVER", 60) / 2, SCREEN_HEIGHT / 2 - 60, 60, COLOR_NEON_RED);
@@ -810,14 +5141,12 @@ void DrawGameUI() {
     }
 }
 
-void DrawBuildUI() {
+void DrawBuildUI(const UiLayout *layout) {
     int uiX = GAME_AREA_WIDTH + 15;
-    int yPos = 180;
-    DrawText("BUILD TOWERS", uiX, yPos, 20, COLOR_UI_ACCENT);
-    yPos += 30;
+    DrawText("BUILD TOWERS", uiX, 180, 20, COLOR_UI_ACCENT);
 
     for (int i = 0; i < TOWER_TYPE_COUNT; i++) {
-        Rectangle buildBox = {uiX - 5, yPos, 180, 80};
+        Rectangle buildBox = FindUIElement(layout, UI_SELECT_BUILD, i)->bounds;
         bool canAfford = playerMoney >= g_towerStats[i][0].cost;
         Color boxColor = (g_selectedBuildType == i) ? COLOR_UI_ACCENT : (canAfford ? COLOR_NEON_CYAN : COLOR_NEON_RED);
 
@@ -825,80 +5154,47 @@ void DrawBuildUI() {
         DrawText(g_towerNames[i], buildBox.x + 10, buildBox.y + 10, 20, canAfford ? WHITE : GRAY);
         DrawText(TextFormat("$%d", g_towerStats[i][0].cost), buildBox.x + 10, buildBox.y + 35, 20, canAfford ? COLOR_NEON_ORANGE : GRAY);
         DrawText(g_towerDescriptions[i], buildBox.x + 10, buildBox.y + 60, 10, GRAY);
-        
-        if (CheckCollisionPointRec(GetMousePosition(), buildBox) && IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
-            if (canAfford) {
-                g_selectedBuildType = i;
-                g_selectedTowerX = -1; g_selectedTowerY = -1;
-            } else {
-                PlaySound(sndError);
-            }
-        }
-        yPos += 90;
     }
 }
 
-void DrawSelectionUI() {
-    int uiX = GAME_AREA_WIDTH + 15;
-    int yPos = 180;
+void DrawSelectionUI(const UiLayout *layout) {
     Tower* tower = &towers[g_selectedTowerX][g_selectedTowerY];
-    TowerLevelStats currentStats = g_towerStats[tower->type][tower->level];
     bool isMaxLevel = tower->level >= MAX_TOWER_LEVEL - 1;
+    TowerLevelStats nextStats = g_towerStats[tower->type][isMaxLevel ? tower->level : tower->level + 1];
 
-    DrawText("TOWER STATS", uiX, yPos, 20, COLOR_UI_ACCENT);
-    yPos += 30;
-    DrawText(TextFormat("%s Lvl %d", g_towerNames[tower->type], tower->level + 1), uiX, yPos, 20, WHITE);
-    yPos += 30;
+    Rectangle stats = FindUIElement(layout, UI_TOWER_STATS, 0)->bounds;
+    DrawText("TOWER STATS", stats.x, stats.y, 20, COLOR_UI_ACCENT);
+    DrawText(TextFormat("%s Lvl %d", g_towerNames[tower->type], tower->level + 1), stats.x, stats.y + UI_STATS_HEADER_HEIGHT / 2, 20, WHITE);
 
     // Show current stats and upgrade potential
-    TowerLevelStats nextStats = isMaxLevel ? currentStats : g_towerStats[tower->type][tower->level + 1];
-    
-    DrawText(TextFormat("Range: %.0f %s", currentStats.range, isMaxLevel ? "" : TextFormat("-> %.0f", nextStats.range)), uiX, yPos, 15, GRAY);
-    yPos += 20;
-
-    if (tower->type == TOWER_SLOW) {
-        DrawText(TextFormat("Slow: %d%% %s", 100 - (int)(currentStats.damage * 100), isMaxLevel ? "" : TextFormat("-> %d%%", 100 - (int)(nextStats.damage * 100))), uiX, yPos, 15, GRAY);
-    } else {
-        DrawText(TextFormat("Damage: %.0f %s", currentStats.damage, isMaxLevel ? "" : TextFormat("-> %.0f", nextStats.damage)), uiX, yPos, 15, GRAY);
+    char lines[MAX_TOWER_STAT_LINES][64];
+    int lineCount = FormatTowerStatLines(tower, lines);
+    for (int i = 0; i < lineCount; i++) {
+        DrawText(lines[i], stats.x, stats.y + UI_STATS_HEADER_HEIGHT + i * UI_STAT_LINE_HEIGHT, 15, GRAY);
     }
-    yPos += 20;
-    DrawText(TextFormat("Fire Rate: %.1f/s %s", currentStats.fireRate, isMaxLevel ? "" : TextFormat("-> %.1f/s", nextStats.fireRate)), uiX, yPos, 15, GRAY);
-    yPos += 40;
 
     // Upgrade Button
     if (!isMaxLevel) {
         bool canAfford = playerMoney >= nextStats.cost;
-        Rectangle upgradeBox = {uiX, yPos, 170, 40};
+        Rectangle upgradeBox = FindUIElement(layout, UI_UPGRADE, 0)->bounds;
         DrawRectangleLinesEx(upgradeBox, 2, canAfford ? COLOR_NEON_CYAN : GRAY);
         DrawText(TextFormat("UPGRADE ($%d)", nextStats.cost), upgradeBox.x + 10, upgradeBox.y + 12, 20, canAfford ? WHITE : GRAY);
-        if (CheckCollisionPointRec(GetMousePosition(), upgradeBox) && IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
-            UpgradeSelectedTower();
-        }
     } else {
-        DrawText("Max Level Reached", uiX, yPos, 20, GOLD);
+        DrawText("Max Level Reached", stats.x, stats.y + stats.height + UI_STATS_GAP, 20, GOLD); // Where the upgrade button would be
     }
-    yPos += 50;
 
     // Sell Button
-    int sellValue = 0;
-    for(int i = 0; i <= tower->level; i++) sellValue += g_towerStats[tower->type][i].cost;
-    sellValue *= 0.7f;
-    Rectangle sellBox = {uiX, yPos, 170, 40};
+    int sellValue = GetTowerSellValue(tower);
+    Rectangle sellBox = FindUIElement(layout, UI_SELL, 0)->bounds;
     DrawRectangleLinesEx(sellBox, 2, COLOR_NEON_RED);
     DrawText(TextFormat("SELL ($%d)", sellValue), sellBox.x + 10, sellBox.y + 12, 20, WHITE);
-    if (CheckCollisionPointRec(GetMousePosition(), sellBox) && IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
-        SellSelectedTower();
-    }
 }
 
 void UpgradeSelectedTower() {
     if (g_selectedTowerX == -1) return;
     Tower* tower = &towers[g_selectedTowerX][g_selectedTowerY];
     if (tower->level < MAX_TOWER_LEVEL - 1) {
-        int cost = g_towerStats[tower->type][tower->level + 1].cost;
-        if (playerMoney >= cost) {
-            playerMoney -= cost;
-            tower->level++;
+        if (IssueCommand((GameCommand){CMD_UPGRADE_TOWER, g_selectedTowerX, g_selectedTowerY, 0})) {
             PlaySound(sndUpgrade);
         } else {
             PlaySound(sndError);
@@ -908,13 +5204,7 @@ void UpgradeSelectedTower() {
 
 void SellSelectedTower() {
     if (g_selectedTowerX == -1) return;
-    Tower* tower = &towers[g_selectedTowerX][g_selectedTowerY];
-    int sellValue = 0;
-    for(int i = 0; i <= tower->level; i++) sellValue += g_towerStats[tower->type][i].cost;
-    sellValue *= 0.7f;
-    
-    playerMoney += sellValue;
-    tower->active = false;
+    if (!IssueCommand((GameCommand){CMD_SELL_TOWER, g_selectedTowerX, g_selectedTowerY, 0})) return;
     g_selectedTowerX = -1;
     g_selectedTowerY = -1;
     PlaySound(sndPlace);
@@ -1000,5 +5290,20 @@ bool FindPathBFS(Vector2 start, Vector2 end) {
         path[i] = path[pathLength - 1 - i];
         path[pathLength - 1 - i] = temp;
     }
+    for (int i = 0; i < pathLength; i++) {
+        pathPoints[i] = (FxVec2){FX_INT((int)path[i].x * cellWidth + cellWidth / 2), FX_INT((int)path[i].y * cellHeight + cellHeight / 2)};
+    }
+    for (int i = 0; i + 1 < pathLength; i++) {
+        int dx = (int)(path[i+1].x - path[i].x), dy = (int)(path[i+1].y - path[i].y);
+        pathNormals[i] = (FxVec2){FX_INT(-dy), FX_INT(dx)};
+    }
+    g_pathGeneration++; // Tower coverage is recomputed against the new path
+    // Links are what the background chunks draw the path from
+    memset(g_pathLinks, 0, sizeof(g_pathLinks));
+    for (int i = 0; i + 1 < pathLength; i++) {
+        int ax = path[i].x, ay = path[i].y, bx = path[i+1].x, by = path[i+1].y;
+        g_pathLinks[ax][ay] |= bx > ax ? CELL_LINK_RIGHT : bx < ax ? CELL_LINK_LEFT : by > ay ? CELL_LINK_DOWN : CELL_LINK_UP;
+        g_pathLinks[bx][by] |= bx > ax ? CELL_LINK_LEFT : bx < ax ? CELL_LINK_RIGHT : by > ay ? CELL_LINK_UP : CELL_LINK_DOWN;
+    }
     return true;
 }
\ No newline at end of file